@@ -0,0 +1,96 @@
+# Reads the header `classname = "<name>"` of a lua script, as LuaFactory does: it has to be
+# the first statement, only preceded by blank lines and line comments.
+# ${result} is set to the classname, or to an empty string if the script has no such header.
+function(lua_script_classname script result)
+    file(READ "${script}" content)
+    # drop leading blank lines and line comments, but not block comments
+    while(content MATCHES "^[ \t\r\n]*--" AND NOT content MATCHES "^[ \t\r\n]*--\\[=*\\[")
+        string(REGEX REPLACE "^[ \t\r\n]*--[^\n]*" "" content "${content}")
+    endwhile()
+    if(content MATCHES "^[ \t\r\n]*classname[ \t]*=[ \t]*[\"']([^\"'\\\n]*)[\"']")
+        set(${result} "${CMAKE_MATCH_1}" PARENT_SCOPE)
+    else()
+        set(${result} "" PARENT_SCOPE)
+    endif()
+endfunction()
+
+# Compiles lua scripts to bytecode with the compiler matching the lua library in use
+# (luac 5.3 or luajit -b). Each compiled file gets the path of its script as resource
+# alias, so it is found at the same place as the plain script would be.
+# ${result} is set to the compiled files and their classname manifests, or to the scripts
+# themselves if no matching compiler was found. Building ${target} builds all compiled files.
+function(compile_lua_scripts target result)
+    qt_parse_all_arguments(luac "compile_lua_scripts" "" "" "FILES" ${ARGN})
+
+    if(USE_LUAJIT)
+        find_program(LUAJIT_EXE NAMES luajit)
+        set(compiler ${LUAJIT_EXE})
+    else()
+        find_program(LUAC_EXE NAMES luac5.3 luac)
+        set(compiler ${LUAC_EXE})
+        if(compiler)
+            # bytecode is only loadable by the exact lua version that created it
+            execute_process(COMMAND ${compiler} -v OUTPUT_VARIABLE version ERROR_VARIABLE version)
+            if(NOT version MATCHES "Lua 5\\.3")
+                message(WARNING "${compiler} is not a Lua 5.3 compiler")
+                set(compiler "")
+            endif()
+        endif()
+    endif()
+    if(NOT compiler)
+        message(WARNING "No lua compiler found, built-in scripts are embedded as source")
+        set(${result} ${luac_FILES} PARENT_SCOPE)
+        return()
+    endif()
+
+    set(compiled_files "")
+    foreach(file ${luac_FILES})
+        set(compiled "${CMAKE_CURRENT_BINARY_DIR}/bytecode/${file}")
+        get_filename_component(compiled_dir "${compiled}" DIRECTORY)
+        if(USE_LUAJIT)
+            # -g keeps debug information, so errors still show line numbers
+            set(compile_command ${compiler} -b -g "${CMAKE_CURRENT_SOURCE_DIR}/${file}" "${compiled}")
+        else()
+            set(compile_command ${compiler} -o "${compiled}" "${CMAKE_CURRENT_SOURCE_DIR}/${file}")
+        endif()
+        add_custom_command(OUTPUT "${compiled}"
+                           COMMAND ${CMAKE_COMMAND} -E make_directory "${compiled_dir}"
+                           COMMAND ${compile_command}
+                           DEPENDS "${file}"
+                           COMMENT "Compiling ${file}"
+                           VERBATIM)
+        set_source_files_properties("${compiled}" PROPERTIES alias "${file}")
+        list(APPEND compiled_files "${compiled}")
+    endforeach()
+
+    # Bytecode can not be searched for the classname header, so the classnames of
+    # each directory are listed in a classnames.txt next to the compiled scripts
+    set(manifest_dirs "")
+    foreach(file ${luac_FILES})
+        set(source "${CMAKE_CURRENT_SOURCE_DIR}/${file}")
+        set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS "${source}")
+        lua_script_classname("${source}" classname)
+        if(NOT classname)
+            continue()
+        endif()
+        get_filename_component(dir "${file}" DIRECTORY)
+        get_filename_component(name "${file}" NAME)
+        string(MAKE_C_IDENTIFIER "${dir}" dir_id)
+        if(NOT dir_id IN_LIST manifest_dirs)
+            list(APPEND manifest_dirs ${dir_id})
+            set(manifest_dir_${dir_id} "${dir}")
+            set(manifest_${dir_id} "")
+        endif()
+        string(APPEND manifest_${dir_id} "${name} ${classname}\n")
+    endforeach()
+    foreach(dir_id ${manifest_dirs})
+        set(manifest "${CMAKE_CURRENT_BINARY_DIR}/bytecode/${manifest_dir_${dir_id}}/classnames.txt")
+        file(GENERATE OUTPUT "${manifest}" CONTENT "${manifest_${dir_id}}")
+        set_source_files_properties("${manifest}" PROPERTIES alias "${manifest_dir_${dir_id}}/classnames.txt")
+        list(APPEND compiled_files "${manifest}")
+    endforeach()
+
+    # several executables embed the scripts, they must not compile them in parallel
+    add_custom_target(${target} DEPENDS ${compiled_files})
+    set(${result} ${compiled_files} PARENT_SCOPE)
+endfunction()
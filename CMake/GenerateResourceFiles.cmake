@@ -32,10 +32,15 @@ function(add_qt_resource target resourceName)
         if (NOT alias)
             set(alias "${file}")
         endif()
+        if(IS_ABSOLUTE "${based_file}")
+            set(source_file "${based_file}")
+        else()
+            set(source_file "${CMAKE_CURRENT_SOURCE_DIR}/${based_file}")
+        endif()
         ### FIXME: escape file paths to be XML conform
         # <file ...>...</file>
         string(APPEND qrcContents "    <file alias=\"${alias}\">")
-        string(APPEND qrcContents "${CMAKE_CURRENT_SOURCE_DIR}/${based_file}</file>\n")
+        string(APPEND qrcContents "${source_file}</file>\n")
     endforeach()
 
     # </qresource></RCC>
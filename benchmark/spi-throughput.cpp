@@ -0,0 +1,69 @@
+/*
+ * Measures how fast the built-in SSD1106 Lua script consumes SPI data,
+ * e.g. to compare a Lua 5.3 build with a -DUSE_LUAJIT=ON build.
+ * Usage: spi-throughput [frames] [burst], burst passes every page as one sendBurst.
+ */
+#include <factory/luaFactory.hpp>
+#if defined(USE_LUAJIT)
+	#include <luajit.h>
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+constexpr unsigned icon_size_minimum = 12;	// 132 pixel wide, like the real display
+
+int main(int argc, char* argv[]) {
+	const unsigned frames = argc > 1 ? stoul(argv[1]) : 200;
+	const bool burst = argc > 2 && string(argv[2]) == "burst";
+
+	LuaFactory factory;
+	unique_ptr<LuaDevice> oled = factory.instantiateDevice("benchmark", "SSD1106");
+	if(!oled) {
+		cerr << "Could not instantiate SSD1106" << endl;
+		return 1;
+	}
+	oled->createBuffer(icon_size_minimum, QPoint(0, 0));
+	const unsigned columns = oled->getBuffer().width();
+	const unsigned pages = oled->getBuffer().height() / 8;
+
+	const auto command = [&oled](gpio::SPI_Command byte) {
+		oled->m_pin->setPin(1, gpio::Tristate::LOW);
+		oled->m_spi->send(byte);
+	};
+
+	vector<gpio::SPI_Command> data(columns);
+	uint64_t bytes = 0;
+	const auto start = chrono::steady_clock::now();
+	for(unsigned frame = 0; frame < frames; frame++) {
+		for(unsigned page = 0; page < pages; page++) {
+			command(0xB0 | page);	// page address
+			command(0x00);			// column low
+			command(0x10);			// column high
+			oled->m_pin->setPin(1, gpio::Tristate::HIGH);
+			for(unsigned column = 0; column < columns; column++) {
+				data[column] = (frame + column) & 0xFF;
+				if(!burst) oled->m_spi->send(data[column]);
+			}
+			if(burst) oled->m_spi->sendBurst(data.data(), data.size(), nullptr);
+			bytes += columns + 3;
+		}
+	}
+	const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+#if defined(USE_LUAJIT)
+	cout << "Backend:    " << LUAJIT_VERSION << endl;
+#else
+	cout << "Backend:    " << LUA_RELEASE << endl;
+#endif
+	cout << "Mode:       " << (burst ? "burst" : "byte by byte") << endl;
+	cout << "Frames:     " << frames << " (" << columns << "x" << pages*8 << ")" << endl;
+	cout << "SPI bytes:  " << bytes << " in " << elapsed.count() << " s" << endl;
+	cout << "Throughput: " << bytes / elapsed.count() / 1000 << " kB/s, "
+			<< frames / elapsed.count() << " frames/s" << endl;
+	return 0;
+}
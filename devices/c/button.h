@@ -4,12 +4,16 @@
 
 class Button : public CDevice {
 	bool m_active = false;
+	bool m_active_low = true;	// bound to config "active_low"
 
 public:
 	Button(const DeviceID& id);
 	~Button();
 
 	inline static DeviceClass m_classname = "button";
+	static constexpr Descriptor<1> descriptor = {2, 2, {{
+		{1, PIN_Interface::Dir::output, "output", 0, 0},
+	}}};
 	const DeviceClass getClass() const override;
 
 	void initializeBuffer() override;
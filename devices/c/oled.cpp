@@ -1,9 +1,12 @@
 #include "oled.h"
 
+#include <array>
+#include <cstring>
+
 OLED::OLED(const DeviceID& id) : CDevice(id) {
 	m_pin = std::make_unique<OLED_PIN>(this);
 	m_spi = std::make_unique<OLED_SPI>(this);
-	m_layout = Layout{11, 6, "rgba"};
+	m_layout = descriptor.getLayout();
 }
 OLED::~OLED() = default;
 
@@ -12,25 +15,47 @@ const DeviceClass OLED::getClass() const { return m_classname; }
 /* Graphbuf Interface */
 
 void OLED::initializeBuffer() {
-	auto *img = m_buffer.bits();
-	for(unsigned x=0; x < m_buffer.width(); x++) {
-		for(unsigned y=0; y < m_buffer.height(); y++) {
-			const auto offs = (y * m_buffer.width() + x) * 4; // heavily depends on rgba8888
-			img[offs+0] = 0;
-			img[offs+1] = 0;
-			img[offs+2] = 0;
-			img[offs+3] = 255;
+	redraw();
+}
+
+void OLED::drawColumn(unsigned page, unsigned column) {
+	const unsigned x = m_state.segment_remap ? ram_columns - 1 - column : column;
+	if(x >= (unsigned)m_buffer.width()) {
+		return;
+	}
+	const uint8_t bit = 1 << (x & 7);	// Format_MonoLSB
+	for(unsigned y=0; y<8; y++) {
+		unsigned row = (page * 8 + y + 2 * ram_lines - m_state.start_line - m_state.offset) % ram_lines;
+		if(m_state.com_scan_reverse) {
+			row = ram_lines - 1 - row;
+		}
+		if(row >= (unsigned)m_buffer.height()) {
+			continue;
 		}
+		const bool set = (m_ram[page][column] >> y) & 1;
+		const bool on = m_state.display_on && (m_state.entire_display_on || set != m_state.invert);
+		uint8_t& pixels = m_buffer.scanLine(row)[x >> 3];
+		pixels = on ? pixels | bit : static_cast<uint8_t>(pixels & ~bit);
 	}
 }
 
+void OLED::redraw() {
+	setPaletteEntry(0, Pixel{0, 0, 0, m_state.contrast});
+	setPaletteEntry(1, Pixel{255, 255, 255, m_state.contrast});
+	for(int row = 0; row < m_buffer.height(); row++) {
+		memset(m_buffer.scanLine(row), 0, m_buffer.bytesPerLine());
+	}
+	for(unsigned page = 0; page < ram_pages; page++) {
+		for(unsigned column = 0; column < ram_columns; column++) {
+			drawColumn(page, column);
+		}
+	}
+	markDirty();
+}
+
 /* PIN Interface */
 
-OLED::OLED_PIN::OLED_PIN(CDevice* device) : CDevice::PIN_Interface_C(device) {
-	m_pinLayout = PinLayout();
-	m_pinLayout.emplace(1, PinDesc{.dir = Dir::input, .name = "data_command", .row = 0, .index=0});
-	m_pinLayout.emplace(2, PinDesc{.dir = Dir::input, .name = "cs", .row = 1, .index = 0});
-}
+OLED::OLED_PIN::OLED_PIN(CDevice* device) : CDevice::PIN_Interface_C(device, descriptor.pins) {}
 
 void OLED::OLED_PIN::setPin(DevicePin num, gpio::Tristate val) {
 	if(num == 1) {
@@ -43,68 +68,148 @@ void OLED::OLED_PIN::setPin(DevicePin num, gpio::Tristate val) {
 
 OLED::OLED_SPI::OLED_SPI(CDevice* device) : CDevice::SPI_Interface_C(device) {}
 
-uint8_t getMask(uint8_t op) {
-	if(op == DISPLAY_START_LINE) {
-		return 0xC0;
+gpio::SPI_Response OLED::OLED_SPI::send(gpio::SPI_Command byte) {
+	auto oled_device = static_cast<OLED*>(m_device);
+	if(oled_device->m_is_data) {
+		oled_device->writeData(byte);
 	}
-	else if(op == COL_LOW || op == COL_HIGH || op == PAGE_ADDR) {
-		return 0xF0;
+	else if(oled_device->m_pending != Op::nop) {
+		const Op op = oled_device->m_pending;
+		oled_device->m_pending = Op::nop;
+		oled_device->argument(op, byte);
 	}
-	else if(op == DISPLAY_ON) {
-		return 0xFE;
+	else {
+		oled_device->command(byte);
 	}
-	return 0xFF;
+	return 0;
 }
 
-std::pair<uint8_t, uint8_t> match(uint8_t cmd) {
-	for(uint8_t op : COMMANDS) {
-		if(((cmd^op)&getMask(op)) == 0) {
-			return {op, cmd&(~getMask(op))};
-		}
+void OLED::writeData(uint8_t byte) {
+	if(m_state.column >= ram_columns || m_state.page >= ram_pages) {
+		return;
 	}
-	return {NOP,0};
+	m_ram[m_state.page][m_state.column] = byte;
+	drawColumn(m_state.page, m_state.column);
+	m_state.column += 1;
+	markDirty();
 }
 
-gpio::SPI_Response OLED::OLED_SPI::send(gpio::SPI_Command byte) {
-	auto oled_device = static_cast<OLED*>(m_device);
-	if(oled_device->m_is_data) {
-		if (oled_device->m_state.column >= m_device->getBuffer().width()) {
-			return 0;
-		}
-		if (oled_device->m_state.page >= m_device->getBuffer().height() / 8) {
-			return 0;
-		}
-		auto *img = m_device->getBuffer().bits();
-		for(unsigned y=0; y<8; y++) {
-			uint8_t pix=0;
-			if(byte & 1<<y) {
-				pix = 255;
-			}
-			const auto offs = (((oled_device->m_state.page * 8) + y) * m_device->getBuffer().width() + oled_device->m_state.column) * 4; // heavily depends on rgba8888
-			img[offs+0] = pix;
-			img[offs+1] = pix;
-			img[offs+2] = pix;
-			img[offs+3] = oled_device->m_state.contrast;
-		}
-		oled_device->m_state.column += 1;
+/* Command decoding */
+
+struct Command {
+	OLED::Op op = OLED::Op::nop;
+	uint8_t payload_mask = 0;		// bits of the command byte that are its parameter
+	bool argument = false;			// followed by an argument byte
+};
+
+static constexpr void setCommands(std::array<Command,256>& table, unsigned first, unsigned last,
+		OLED::Op op, uint8_t payload_mask = 0, bool argument = false) {
+	for(unsigned byte = first; byte <= last; byte++) {
+		table[byte] = Command{op, payload_mask, argument};
 	}
-	else {
-		std::pair<uint8_t, uint8_t> op_payload = match(byte);
-		if(op_payload.first == DISPLAY_START_LINE) {
-			return 0;
-		}
-		else if(op_payload.first == COL_LOW) {
-			oled_device->m_state.column = (oled_device->m_state.column & 0xf0) | op_payload.second;
-		}
-		else if(op_payload.first == COL_HIGH) {
-			oled_device->m_state.column = (oled_device->m_state.column & 0x0f) | (op_payload.second << 4);
-		}
-		else if(op_payload.first == PAGE_ADDR) {
-			oled_device->m_state.page = op_payload.second;
-		}
-		else if(op_payload.first == DISPLAY_ON) {
-			oled_device->m_state.display_on = op_payload.second;
+}
+
+/* SSD1106 command set, unknown bytes are ignored like NOP */
+static constexpr std::array<Command,256> buildCommandTable() {
+	std::array<Command,256> table{};
+	setCommands(table, 0x00, 0x0F, OLED::Op::col_low, 0x0F);
+	setCommands(table, 0x10, 0x1F, OLED::Op::col_high, 0x0F);
+	setCommands(table, 0x30, 0x33, OLED::Op::pump_voltage, 0x03);
+	setCommands(table, 0x40, 0x7F, OLED::Op::display_start_line, 0x3F);
+	setCommands(table, 0x81, 0x81, OLED::Op::contrast, 0, true);
+	setCommands(table, 0xA0, 0xA1, OLED::Op::segment_remap, 0x01);
+	setCommands(table, 0xA4, 0xA5, OLED::Op::entire_display_on, 0x01);
+	setCommands(table, 0xA6, 0xA7, OLED::Op::invert, 0x01);
+	setCommands(table, 0xA8, 0xA8, OLED::Op::multiplex_ratio, 0, true);
+	setCommands(table, 0xAD, 0xAD, OLED::Op::dc_dc, 0, true);
+	setCommands(table, 0xAE, 0xAF, OLED::Op::display_on, 0x01);
+	setCommands(table, 0xB0, 0xB7, OLED::Op::page_addr, 0x07);
+	setCommands(table, 0xC0, 0xCF, OLED::Op::com_scan_reverse, 0x08);
+	setCommands(table, 0xD3, 0xD3, OLED::Op::display_offset, 0, true);
+	setCommands(table, 0xD5, 0xD5, OLED::Op::clock_divide, 0, true);
+	setCommands(table, 0xD9, 0xD9, OLED::Op::precharge_period, 0, true);
+	setCommands(table, 0xDA, 0xDA, OLED::Op::com_pads, 0, true);
+	setCommands(table, 0xDB, 0xDB, OLED::Op::vcom_deselect, 0, true);
+	setCommands(table, 0xE0, 0xE0, OLED::Op::read_modify_write);
+	setCommands(table, 0xE3, 0xE3, OLED::Op::nop);
+	setCommands(table, 0xEE, 0xEE, OLED::Op::end);
+	return table;
+}
+
+static constexpr std::array<Command,256> command_table = buildCommandTable();
+
+static_assert(command_table[0x81].argument, "contrast consumes the following byte");
+static_assert(command_table[0xC8].op == OLED::Op::com_scan_reverse && (0xC8 & command_table[0xC8].payload_mask));
+
+void OLED::command(uint8_t byte) {
+	const Command& cmd = command_table[byte];
+	if(cmd.argument) {
+		m_pending = cmd.op;
+		return;
+	}
+	const uint8_t payload = byte & cmd.payload_mask;
+	switch(cmd.op) {
+	case Op::col_low:
+		m_state.column = (m_state.column & 0xf0) | payload;
+		break;
+	case Op::col_high:
+		m_state.column = (m_state.column & 0x0f) | (payload << 4);
+		break;
+	case Op::page_addr:
+		m_state.page = payload;
+		break;
+	case Op::display_start_line:
+		m_state.start_line = payload;
+		redraw();
+		break;
+	case Op::segment_remap:
+		m_state.segment_remap = payload;
+		redraw();
+		break;
+	case Op::com_scan_reverse:
+		m_state.com_scan_reverse = payload;
+		redraw();
+		break;
+	case Op::entire_display_on:
+		m_state.entire_display_on = payload;
+		redraw();
+		break;
+	case Op::invert:
+		m_state.invert = payload;
+		redraw();
+		break;
+	case Op::display_on:
+		m_state.display_on = payload;
+		redraw();
+		break;
+	case Op::read_modify_write:
+		m_state.read_modify_write = true;
+		m_state.rmw_column = m_state.column;
+		break;
+	case Op::end:
+		if(m_state.read_modify_write) {
+			m_state.read_modify_write = false;
+			m_state.column = m_state.rmw_column;
 		}
+		break;
+	default:
+		// pump voltage and NOP do not change the picture
+		break;
+	}
+}
+
+void OLED::argument(Op op, uint8_t byte) {
+	switch(op) {
+	case Op::contrast:
+		m_state.contrast = byte;
+		redraw();
+		break;
+	case Op::display_offset:
+		m_state.offset = byte & 0x3F;
+		redraw();
+		break;
+	default:
+		// multiplex ratio, DC-DC, timing and pad settings do not change the picture
+		break;
 	}
-	return 0;
 }
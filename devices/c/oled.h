@@ -4,35 +4,78 @@
 #include <inttypes.h>
 
 
-const uint8_t COL_LOW= 0;
-const uint8_t COL_HIGH = 0x10;
-const uint8_t PUMP_VOLTAGE = 0x30;
-const uint8_t DISPLAY_START_LINE = 0x40;
-const uint8_t CONTRAST_MODE_SET = 0x81;
-const uint8_t DISPLAY_ON = 0xAE;
-const uint8_t PAGE_ADDR = 0xB0;
-const uint8_t NOP = 0xE3;
-
-const uint8_t COMMANDS [8] = {COL_LOW, COL_HIGH, PUMP_VOLTAGE, DISPLAY_START_LINE, CONTRAST_MODE_SET, DISPLAY_ON, PAGE_ADDR, NOP};
-
-
+/**
+ * SSD1106 controller: commands are decoded by a lookup table, the display RAM
+ * (132 columns x 8 pages) is kept so that mode changes (remap, scan direction,
+ * offset, start line, invert) can be redrawn from it. The buffer is 1 bpp,
+ * contrast is applied through its colour table.
+ */
 class OLED : public CDevice {
+public:
+	static constexpr unsigned ram_columns = 132;
+	static constexpr unsigned ram_pages = 8;
+	static constexpr unsigned ram_lines = ram_pages * 8;
 
+	enum class Op : uint8_t {
+		nop,
+		col_low,
+		col_high,
+		pump_voltage,
+		display_start_line,
+		contrast,				// + argument
+		segment_remap,
+		entire_display_on,
+		invert,
+		multiplex_ratio,		// + argument
+		dc_dc,					// + argument
+		display_on,
+		page_addr,
+		com_scan_reverse,
+		display_offset,			// + argument
+		clock_divide,			// + argument
+		precharge_period,		// + argument
+		com_pads,				// + argument
+		vcom_deselect,			// + argument
+		read_modify_write,
+		end,
+	};
+
+private:
 	struct State {
 		unsigned column = 0;
 		unsigned page = 0;
 		uint8_t contrast = 255;
 		bool display_on = true;
+		bool entire_display_on = false;
+		bool invert = false;
+		bool segment_remap = false;
+		bool com_scan_reverse = false;
+		uint8_t start_line = 0;
+		uint8_t offset = 0;
+		bool read_modify_write = false;
+		unsigned rmw_column = 0;	// restored on end of read-modify-write
 	};
 
 	bool m_is_data = false;
+	Op m_pending = Op::nop;			// command still waiting for its argument
 	State m_state;
+	uint8_t m_ram[ram_pages][ram_columns] = {};
+
+	void command(uint8_t byte);
+	void argument(Op op, uint8_t byte);
+	void writeData(uint8_t byte);
+	void drawColumn(unsigned page, unsigned column);
+	void redraw();
 
 public:
 	OLED(const DeviceID& id);
 	~OLED();
 
 	inline static DeviceClass m_classname = "oled";
+	static constexpr Descriptor<2> descriptor = {11, 6, {{
+		{1, PIN_Interface::Dir::input, "data_command", 0, 0},
+		{2, PIN_Interface::Dir::input, "cs", 1, 0},
+	}}, "mono"};
 	const DeviceClass getClass() const override;
 
 	void initializeBuffer() override;
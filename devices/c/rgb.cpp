@@ -1,10 +1,8 @@
 #include "rgb.h"
 
-#include <cmath>
-
 RGB::RGB(const DeviceID& id) : CDevice(id) {
 	m_pin = std::make_unique<RGB_Pin>(this);
-	m_layout = Layout{3, 1, "rgba"};
+	m_layout = descriptor.getLayout();
 }
 
 RGB::~RGB() = default;
@@ -14,44 +12,20 @@ const DeviceClass RGB::getClass() const { return m_classname; }
 /* Graph */
 
 void RGB::initializeBuffer() {
-	for(PIN_Interface::DevicePin num=0; num<=2; num++) {
-		draw(0, false);
-	}
+	fillGlow(m_colour);
 }
 
 void RGB::draw(PIN_Interface::DevicePin num, bool val) {
 	if(num > 2) { return; }
-	int extent_center = std::ceil(m_buffer.height() / (float)2);
-	Pixel cur = getPixel(extent_center, extent_center);
-	if(num == 0) cur.r = val?255:0;
-	else if(num == 1) cur.g = val?255:0;
-	else cur.b = val?255:0;
-
-	auto *img = m_buffer.bits();
-	for(int x=1; x < m_buffer.width(); x++) {
-		for(int y=1; y < m_buffer.height(); y++) {
-			float dist = std::sqrt(pow(extent_center - x, 2) + pow(extent_center - y, 2));
-			int norm_lumen = std::floor((1-dist/extent_center)*255);
-			if(norm_lumen < 0) norm_lumen = 0;
-			if(norm_lumen > 255) norm_lumen = 255;
-
-			const auto offs = ((y-1) * m_buffer.width() + (x - 1)) * 4; // heavily depends on rgba8888
-			img[offs+0] = cur.r;
-			img[offs+1] = cur.g;
-			img[offs+2] = cur.b;
-			img[offs+3] = (uint8_t)norm_lumen;
-		}
-	}
+	if(num == 0) m_colour.r = val?255:0;
+	else if(num == 1) m_colour.g = val?255:0;
+	else m_colour.b = val?255:0;
+	fillGlow(m_colour);
 }
 
 /* PIN */
 
-RGB::RGB_Pin::RGB_Pin(CDevice* device) : CDevice::PIN_Interface_C(device) {
-	m_pinLayout = PinLayout();
-	m_pinLayout.emplace(0, PinDesc{.dir=Dir::input, .name="r", .row=0, .index=0});
-	m_pinLayout.emplace(1, PinDesc{.dir=Dir::input, .name="g", .row=1, .index=0});
-	m_pinLayout.emplace(2, PinDesc{.dir=Dir::input, .name="b", .row=2, .index=0});
-}
+RGB::RGB_Pin::RGB_Pin(CDevice* device) : CDevice::PIN_Interface_C(device, descriptor.pins) {}
 
 void RGB::RGB_Pin::setPin(DevicePin num, gpio::Tristate val) {
 	if(num <= 2) {
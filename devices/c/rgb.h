@@ -3,12 +3,18 @@
 #include <cFactory.h>
 
 class RGB : public CDevice {
+	Pixel m_colour = {0, 0, 0, 255};
 
 public:
 	RGB(const DeviceID& id);
 	~RGB();
 
 	inline static DeviceClass m_classname = "rgb";
+	static constexpr Descriptor<3> descriptor = {3, 1, {{
+		{0, PIN_Interface::Dir::input, "r", 0, 0},
+		{1, PIN_Interface::Dir::input, "g", 1, 0},
+		{2, PIN_Interface::Dir::input, "b", 2, 0},
+	}}};
 	const DeviceClass getClass() const override;
 
 	void initializeBuffer() override;
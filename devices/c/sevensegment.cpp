@@ -2,7 +2,7 @@
 
 Sevensegment::Sevensegment(const DeviceID& id) : CDevice(id) {
 	m_pin = std::make_unique<Segment_PIN>(this);
-	m_layout = Layout{4, 5, "rgba"};
+	m_layout = descriptor.getLayout();
 }
 
 Sevensegment::~Sevensegment() = default;
@@ -72,21 +72,12 @@ void Sevensegment::draw(PIN_Interface::DevicePin num, bool val) {
 			img[offs+3] = 255;
 		}
 	}
+	markDirty();
 }
 
 /* PIN Interface */
 
-Sevensegment::Segment_PIN::Segment_PIN(CDevice* device) : CDevice::PIN_Interface_C(device) {
-	m_pinLayout = PinLayout();
-	m_pinLayout.emplace(0, PinDesc{.dir=Dir::input, .name="top", .row=1, .index=0});
-	m_pinLayout.emplace(1, PinDesc{.dir=Dir::input, .name="top_right", .row=3, .index=1});
-	m_pinLayout.emplace(2, PinDesc{.dir=Dir::input, .name="bottom_right", .row=3, .index=3});
-	m_pinLayout.emplace(3, PinDesc{.dir=Dir::input, .name="bottom", .row=1, .index=4});
-	m_pinLayout.emplace(4, PinDesc{.dir=Dir::input, .name="bottom_left", .row=0, .index=3});
-	m_pinLayout.emplace(5, PinDesc{.dir=Dir::input, .name="top_left", .row=0, .index=1});
-	m_pinLayout.emplace(6, PinDesc{.dir=Dir::input, .name="center", .row=2, .index=0});
-	m_pinLayout.emplace(7, PinDesc{.dir=Dir::input, .name="dot", .row=2, .index=4});
-}
+Sevensegment::Segment_PIN::Segment_PIN(CDevice* device) : CDevice::PIN_Interface_C(device, descriptor.pins) {}
 
 void Sevensegment::Segment_PIN::setPin(DevicePin num, gpio::Tristate val) {
 	if(num <= 7) {
@@ -9,6 +9,16 @@ public:
 	~Sevensegment();
 
 	inline static DeviceClass m_classname = "sevensegment";
+	static constexpr Descriptor<8> descriptor = {4, 5, {{
+		{0, PIN_Interface::Dir::input, "top", 1, 0},
+		{1, PIN_Interface::Dir::input, "top_right", 3, 1},
+		{2, PIN_Interface::Dir::input, "bottom_right", 3, 3},
+		{3, PIN_Interface::Dir::input, "bottom", 1, 4},
+		{4, PIN_Interface::Dir::input, "bottom_left", 0, 3},
+		{5, PIN_Interface::Dir::input, "top_left", 0, 1},
+		{6, PIN_Interface::Dir::input, "center", 2, 0},
+		{7, PIN_Interface::Dir::input, "dot", 2, 4},
+	}}};
 	const DeviceClass getClass() const override;
 
 	void initializeBuffer() override;
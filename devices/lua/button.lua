@@ -20,13 +20,13 @@ is_active = false
 function getPin(number)
 	if number == 1 then
 		if is_active and active_low then
-			return "LOW"
+			return gpio.LOW
 		else if is_active then
-			return "HIGH"
+			return gpio.HIGH
 		end
 		end
 	end
-	return "UNSET"
+	return gpio.UNSET
 end
 
 function getGraphBufferLayout()
@@ -34,14 +34,10 @@ function getGraphBufferLayout()
 end
 
 function drawArea()
-	for x = 0, buffer_width-1 do
-		for y = 0, buffer_height-1 do
-			if is_active then
-				setGraphbuffer(x, y, graphbuf.Pixel(255,0,0,128))
-			else
-				setGraphbuffer(x, y, graphbuf.Pixel(0,0,0,128))
-			end
-		end
+	if is_active then
+		fillGraphbuffer(0, 0, buffer_width, buffer_height, graphbuf.rgba(255,0,0,128))
+	else
+		fillGraphbuffer(0, 0, buffer_width, buffer_height, graphbuf.rgba(0,0,0,128))
 	end
 end
 
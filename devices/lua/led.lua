@@ -32,19 +32,10 @@ function getGraphBufferLayout()
     return {1, 1, "rgba"}
 end
 
--- graphbuf.Pixel(r, g, b, a) Where values range from 0-255 where 255 is color/opaque
--- setGraphbuffer(x, y, Pixel)
+-- graphbuf.rgba(r, g, b, a) Where values range from 0-255 where 255 is color/opaque
+-- fillGraphbufferGlow(rgba) fills the buffer, alpha fading from the center
 local function setLED(r, g, b)
-	local extent_center = math.ceil(buffer_width/2)
-	for x = 1, buffer_width do
-		for y = 1, buffer_height do
-			local dist = math.sqrt((extent_center - x) ^ 2 + (extent_center - y) ^ 2)
-			local norm_lumen = math.floor((1-dist/extent_center)*255)
-			if norm_lumen < 0 then norm_lumen = 0 end
-			if norm_lumen > 255 then norm_lumen = 255 end
-			setGraphbuffer(x-1, y-1, graphbuf.Pixel(math.floor(r), math.floor(g), math.floor(b), norm_lumen))
-		end
-	end
+	fillGraphbufferGlow(graphbuf.rgba(math.floor(r), math.floor(g), math.floor(b), 255))
 end
 
 -- optional
@@ -5,13 +5,23 @@ classname = "RTC_0815"
 is_cs_active = False
 last_time = 0
 
+-- seconds since epoch, advanced on the simulation clock
+seconds = os.time(os.date("!*t"))
+
+spawn(function ()
+    while true do
+        sleep(1000)
+        seconds = seconds + 1
+    end
+end)
+
 time_width_bytes = 4
 
 function setCS(bool_on)
     -- print ("RTC: setCS")
     is_cs_active = bool_on
     if bool_on then
-        last_time = os.time(os.date("!*t"))
+        last_time = seconds
         state = 0
     end
 end
@@ -19,10 +29,11 @@ end
 function receiveSPI(byte_in)
     -- print ("RTC: receiveSPI " .. byte_in)
     if is_cs_active then
-        if byte_in > time_width_bytes then
+        -- shift counts are taken mod 32 by the bit library, so byte 4 would wrap to byte 0
+        if byte_in >= time_width_bytes then
             return 0
         else
-            r = ((0xFF << (8*byte_in)) & last_time) >> (8*byte_in)
+            r = bit.rshift(bit.band(bit.lshift(0xFF, 8*byte_in), last_time), 8*byte_in)
             return r
         end
     end
@@ -8,8 +8,9 @@ function getPinLayout ()
 end
 
 function getGraphBufferLayout()
-	-- raster width, raster height, data type (currently only rgba)
-	return {11, 6, "rgba"}
+	-- raster width, raster height, data type (rgba, rgb565, mono or palette8)
+	-- mono is stored with one bit per pixel, black and white unless set by setGraphbufferPalette
+	return {11, 6, "mono"}
 end
 
 local isData
@@ -22,11 +23,7 @@ end
 
 -- optional
 function initializeGraphBuffer()
-	for x = 0, buffer_width-1 do
-		for y = 0, buffer_height-1 do
-			setGraphbuffer(x, y, graphbuf.Pixel(0,0,0, 255))
-		end
-	end
+	fillGraphbuffer(0, 0, buffer_width, buffer_height, graphbuf.rgba(0,0,0, 255))
 end
 
 operators = {
@@ -57,10 +54,10 @@ function match(cmd)
 	--print ("searching for " .. tostring(cmd))
 	for key, op in pairs(operators) do
 		--print ("testing " .. key .. " (" .. tostring(op) .. ") with mask " .. tostring(getMask(op)))
-		--print (" difference: " .. tostring(cmd ~ op))
-		if ( (cmd ~ op) & getMask(op) ) == 0 then
+		--print (" difference: " .. tostring(bit.bxor(cmd, op)))
+		if bit.band(bit.bxor(cmd, op), getMask(op)) == 0 then
 			--print ("Matched " .. key)
-			return op, cmd & (~getMask(op))
+			return op, bit.band(cmd, bit.bnot(getMask(op)))
 		end
 	end
 	return operators.NOP, 0
@@ -73,8 +70,8 @@ local state = {
 	display_on = true
 }
 
--- graphbuf.Pixel(r, g, b, a) Where values range from 0-255 where 255 is color/opaque
--- setGraphbuffer(x, y, Pixel)
+-- graphbuf.rgba(r, g, b, a) Where values range from 0-255 where 255 is color/opaque
+-- setGraphbufferColumnBits(x, y, bits, count, on, off) sets count pixels downwards, lowest bit on top
 function receiveSPI(byte_in)
 	if isData then
 		-- print( " data at " .. tostring(state.column))
@@ -86,24 +83,17 @@ function receiveSPI(byte_in)
 			print ( "LUA_OLED: Warning, exceeding page")
 			return 0
 		end
-		for y = 0,7 do
-			if (byte_in & 1 << y) > 0 then
-				pix = 255
-			else
-				pix = 0
-			end
-			--print ( tostring(state.column) .. " x " .. tostring((state.page*8)+y) .. " to " .. tostring(pix))
-			setGraphbuffer(state.column, (state.page*8)+y, graphbuf.Pixel(pix,pix,pix, state.contrast))
-		end
+		setGraphbufferColumnBits(state.column, state.page*8, byte_in, 8,
+			graphbuf.rgba(255,255,255, state.contrast), graphbuf.rgba(0,0,0, state.contrast))
 		state.column = state.column + 1
 	else
 		op, payload = match(byte_in)
 		if     op == operators.DISPLAY_START_LINE then
 			return 0
 		elseif op == operators.COL_LOW then
-			state.column = (state.column & 0xf0) | payload
+			state.column = bit.bor(bit.band(state.column, 0xf0), payload)
 		elseif op == operators.COL_HIGH then
-			state.column = (state.column & 0x0f) | (payload << 4)
+			state.column = bit.bor(bit.band(state.column, 0x0f), bit.lshift(payload, 4))
 		elseif op == operators.PAGE_ADDR then
 			state.page = payload
 		elseif op == operators.DISPLAY_ON then
@@ -115,6 +105,12 @@ function receiveSPI(byte_in)
 	return 0
 end
 
+-- optional, all bytes of a burst as one string, if the channel does not need responses
+function receiveSPIBurst(bytes)
+	for i = 1, #bytes do
+		receiveSPI(string.byte(bytes, i))
+	end
+end
 
 function debug_printAll(table)
     print("given table:\n")
@@ -16,23 +16,7 @@ void Breadboard::printConnections() {
 			cout << "\t\t\tDevice " << device.id << " with device pin " << device.pin << endl;
 		}
 	}
-	cout << "Connections:" << endl;
-	cout << "\tAsync writing:" << endl;
-	for(const PinMapping& mapping : m_writing_connections) {
-		cout << "\t\tGlobal pin " << (int) mapping.global_pin << " connected with device " << mapping.device << endl;
-	}
-	cout << "\tAsync reading:" << endl;
-	for(const PinMapping& mapping : m_reading_connections) {
-		cout << "\t\tGlobal pin " << (int) mapping.global_pin << " connected with device " << mapping.device << endl;
-	}
-	cout << "\tSync pins:" << endl;
-	for(const auto& [device_id, req] : m_pin_channels) {
-		cout << "\t\tGlobal pin " << (int) req.global_pin << " connected with device " << device_id << endl;
-	}
-	cout << "\tSync SPI:" << endl;
-	for(const auto& [device_id, req] : m_spi_channels) {
-		cout << "\t\tGlobal pin " << (int) req.global_pin << " connected with device " << device_id << endl;
-	}
+	m_circuit.printConnections();
 	cout << "--------------------------" << endl;
 }
 
@@ -44,17 +28,17 @@ Breadboard::Row Breadboard::removeConnection(const DeviceID& device_id, Device::
 		cerr << "[Breadboard] Could not find the device pin in the connection raster" << endl;
 		return invalidRasterRow();
 	}
-	unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber> current_globals = getPinsToDevicePins(device_id);
+	unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber> current_globals = m_circuit.getPinsToDevicePins(device_id);
 	auto old_pin = current_globals.find(device_pin);
-	if(old_pin != current_globals.end() && m_embedded->isPin(old_pin->second)) {
+	if(old_pin != current_globals.end() && m_embedded->getBoard().isPin(old_pin->second)) {
 		removePin(old_pin->second, false);
 	}
 	return row;
 }
 
 void Breadboard::addPinToDevicePin(const DeviceID& device_id, Device::PIN_Interface::DevicePin device_pin, gpio::PinNumber global, std::string name) {
-	auto device = m_devices.find(device_id);
-	if(device == m_devices.end() || !device->second->m_pin) {
+	Device* device = m_circuit.getDevice(device_id);
+	if(!device || !device->m_pin) {
 		m_error_dialog->showMessage("Device does not implement pin interface.");
 		return;
 	}
@@ -70,7 +54,7 @@ void Breadboard::addPinToRow(Row row, Index index, gpio::PinNumber global, std::
 
 void Breadboard::addPinToRowContent(Row row, Index index, gpio::PinNumber global, std::string name) {
 	if(isBreadboard() && (!isValidRasterIndex(index) || !isValidRasterRow(row))) return;
-	if(!m_embedded->isPin(global)) return;
+	if(!m_embedded->getBoard().isPin(global)) return;
 	removeSPI(global, false);
 	removePin(global, false);
 	PinConnection new_connection = PinConnection{
@@ -101,49 +85,14 @@ void Breadboard::createRowConnections(Row row) {
 		cerr << "[Breadboard] Could not find row " << row << endl;
 		return;
 	}
-	GPIOPinLayout embedded_pins = m_embedded->getPins();
 	for (auto &device_obj: row_obj->second.devices) {
-		unordered_set<gpio::PinNumber> connected = getPinsToDevice(device_obj.id);
+		unordered_set<gpio::PinNumber> connected = m_circuit.getPinsToDevice(device_obj.id);
 		for(const auto& pin_obj : row_obj->second.pins) {
 			if(connected.contains(pin_obj.global_pin)) continue;
-			auto e_pin = embedded_pins.find(pin_obj.global_pin);
-			if(e_pin == embedded_pins.end()) continue;
-			bool iof_set = false;
-			for(auto iof : e_pin->second.iofs) {
-				if(iof.type == IOFType::SPI && iof.active) {
-					registerSPI(pin_obj.global_pin, device_obj.pin, device_obj.id, true);
-					iof_set = true;
-					break;
-				}
-			}
-			if(!iof_set) {
-				registerPin(pin_obj.global_pin, device_obj.pin, device_obj.id);
-			}
-		}
-	}
-}
-
-unordered_set<gpio::PinNumber> Breadboard::getPinsToDevice(const DeviceID& device_id) {
-	unordered_set<gpio::PinNumber> connected_global;
-	auto sync_pin = m_pin_channels.find(device_id);
-	if(sync_pin != m_pin_channels.end()) {
-		connected_global.insert(sync_pin->second.global_pin);
-	}
-	auto spi = m_spi_channels.find(device_id);
-	if(spi != m_spi_channels.end()) {
-		connected_global.insert(spi->second.global_pin);
-	}
-	for(const auto& mapping : m_reading_connections) {
-		if(mapping.device == device_id) {
-			connected_global.insert(mapping.global_pin);
+			if(!m_embedded->getBoard().isPin(pin_obj.global_pin)) continue;
+			m_circuit.addConnection(pin_obj.global_pin, device_obj.pin, device_obj.id);
 		}
 	}
-	for(const auto& mapping : m_writing_connections) {
-		if(mapping.device == device_id) {
-			connected_global.insert(mapping.global_pin);
-		}
-	}
-	return connected_global;
 }
 
 std::string Breadboard::getPinName(gpio::PinNumber global) {
@@ -154,108 +103,9 @@ std::string Breadboard::getPinName(gpio::PinNumber global) {
 	return "";
 }
 
-unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber> Breadboard::getPinsToDevicePins(const DeviceID& device_id) {
-	unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber> connected_global;
-	auto device = m_devices.find(device_id);
-	if(device == m_devices.end() || !device->second->m_pin) return connected_global;
-	auto sync = m_pin_channels.find(device_id);
-	if(sync!=m_pin_channels.end()) {
-		connected_global.emplace(sync->second.device_pin, sync->second.global_pin);
-	}
-	auto spi = m_spi_channels.find(device_id);
-	if(spi!=m_spi_channels.end()) {
-		connected_global.emplace(spi->second.cs_pin, spi->second.global_pin);
-	}
-	for(const auto& mapping : m_reading_connections) {
-		if(mapping.device == device_id) {
-			connected_global.emplace(mapping.device_pin, mapping.global_pin);
-		}
-	}
-	for(const auto& mapping : m_writing_connections) {
-		if(mapping.device == device_id) {
-			connected_global.emplace(mapping.device_pin, mapping.global_pin);
-		}
-	}
-	// invalid for all other device pins
-	m_lua_access.lock();
-	for(const auto& [device_pin, desc] : device->second->m_pin->getPinLayout()) {
-		if(!connected_global.contains(device_pin)) {
-			connected_global.emplace(device_pin, numeric_limits<gpio::PinNumber>::max());
-		}
-	}
-	m_lua_access.unlock();
-	return connected_global;
-}
-
-void Breadboard::registerPin(gpio::PinNumber global, Device::PIN_Interface::DevicePin device_pin, const DeviceID& device_id, bool synchronous) {
-	auto device = m_devices.find(device_id);
-	if(device == m_devices.end()) {
-		cerr << "[Breadboard] Could not find device '" << device_id << "' when attempting to register pin " << (int) global << endl;
-		removeDevice(device_id);
-		return;
-	}
-	if(!device->second->m_pin) {
-		cerr << "[Breadboard] Attempting to add pin connection for device '" << device_id <<
-			 "', but device does not implement PIN interface." << endl;
-		return;
-	}
-	m_lua_access.lock();
-	const Device::PIN_Interface::PinLayout layout = device->second->m_pin->getPinLayout();
-	m_lua_access.unlock();
-	if(layout.find(device_pin) == layout.end()) {
-		cerr << "[Breadboard] Attempting to add pin '" << (int)device_pin << "' for device " <<
-			 device_id << " that is not offered by device" << endl;
-		return;
-	}
-	const Device::PIN_Interface::PinDesc& desc = layout.at(device_pin);
-	if(synchronous) {
-		if(desc.dir != Device::PIN_Interface::Dir::input) {
-			cerr << "[Breadboard] Attempting to add pin '" << (int)device_pin << "' as synchronous for device " <<
-				 device_id << ", but device labels pin not as input."
-									   " This is not supported for inout-pins and unnecessary for output pins." << endl;
-			return;
-		}
-		auto device_ptr = device->second.get();
-		m_lua_access.lock();
-		device_ptr->initializeBuffer();
-		m_lua_access.unlock();
-		auto req = PIN_IOF_Request{
-				.global_pin = global,
-				.device_pin = device_pin,
-				.fun = [this, device_ptr, device_pin](gpio::Tristate pin) {
-					m_lua_access.lock();
-					device_ptr->m_pin->setPin(device_pin, pin);
-					m_lua_access.unlock();
-				}};
-		m_pin_channels.emplace(device_id, req);
-		if(m_embedded->gpioConnected()) {
-			m_embedded->registerIOF_PIN(req.global_pin, req.fun);
-		}
-	}
-	else {
-		PinMapping mapping = PinMapping{
-				.global_pin = global,
-				.device_pin = device_pin,
-				.device = device_id
-		};
-		if(desc.dir == Device::PIN_Interface::Dir::input || desc.dir == Device::PIN_Interface::Dir::inout) {
-			m_reading_connections.push_back(mapping);
-		}
-		else if(desc.dir == Device::PIN_Interface::Dir::output) {
-			m_writing_connections.push_back(mapping);
-		}
-	}
-}
-
-void Breadboard::setPinSync(gpio::PinNumber global, Device::PIN_Interface::DevicePin device_pin, const DeviceID& device_id, bool synchronous) {
-	removeSPI(global, true);
-	removePinForDevice(global, device_id);
-	registerPin(global, device_pin, device_id, synchronous);
-}
-
 void Breadboard::setSPI(gpio::PinNumber global, bool active) {
 	if(!active) {
-		removeSPI(global, true);
+		m_circuit.removeSPI(global);
 	}
 	else {
 		removePin(global, true);
@@ -265,112 +115,28 @@ void Breadboard::setSPI(gpio::PinNumber global, bool active) {
 	}
 }
 
-void Breadboard::registerSPI(gpio::PinNumber global, Device::PIN_Interface::DevicePin cs_pin, const DeviceID& device_id, bool noresponse) {
-	auto device = m_devices.find(device_id);
-	if(device == m_devices.end()) {
-		cerr << "[Breadboard] Could not find device '" << device_id << "' when attempting to register SPI" << endl;
-		removeDevice(device_id);
-		return;
-	}
-	if(!device->second->m_spi) {
-		cerr << "[Breadboard] Attempting to add SPI connection for device '" << device_id <<
-			 "', but device does not implement SPI interface." << endl;
-		return;
-	}
-	auto device_ptr = device->second.get();
-	m_lua_access.lock();
-	device_ptr->initializeBuffer();
-	m_lua_access.unlock();
-	auto req = SPI_IOF_Request{
-			.global_pin = global,
-			.cs_pin = cs_pin,
-			.noresponse = noresponse,
-			.fun = [this, device_ptr](gpio::SPI_Command cmd){
-				m_lua_access.lock();
-				const gpio::SPI_Response ret = device_ptr->m_spi->send(cmd);
-				m_lua_access.unlock();
-				return ret;
-			}};
-	m_spi_channels.emplace(device_id, req);
-	if(m_embedded->gpioConnected()) {
-		m_embedded->registerIOF_SPI(req.global_pin, req.fun, req.noresponse);
-	}
-}
-
-void Breadboard::setSPInoresponse(gpio::PinNumber global, bool noresponse) {
-	for(auto& [device, spi] : m_spi_channels) {
-		if(spi.global_pin == global) {
-			Device::PIN_Interface::DevicePin cs_pin = spi.cs_pin;
-			DeviceID device_id = device;
-			removeSPI(global, true);
-			registerSPI(global, cs_pin, device_id, noresponse);
-			break;
-		}
-	}
-}
-
 /* Remove */
 
 void Breadboard::removeSPI(gpio::PinNumber global, bool keep_on_raster) {
-	bool exists = find_if(m_spi_channels.begin(), m_spi_channels.end(),
-						  [global](const auto& spi_pair){
-							  return spi_pair.second.global_pin == global;
-						  }) != m_spi_channels.end();
-	if(exists) {
-		m_embedded->closeIOF(global);
-		erase_if(m_spi_channels, [global](const auto& spi_pair){
-			return spi_pair.second.global_pin == global;
-		});
-	}
+	m_circuit.removeSPI(global);
 	if(!keep_on_raster) {
 		removePinFromRaster(global);
 	}
 }
 
-void Breadboard::removeSPIForDevice(gpio::PinNumber global, const DeviceID& device_id) {
-	auto req = m_spi_channels.find(device_id);
-	if(req == m_spi_channels.end() || req->second.global_pin != global) return;
-	m_embedded->closeIOF(global);
-	m_spi_channels.erase(device_id);
-}
-
 void Breadboard::removePin(gpio::PinNumber global, bool keep_on_raster) {
-	bool exists = find_if(m_pin_channels.begin(), m_pin_channels.end(),
-						  [global](const auto& pin_pair){
-							  return pin_pair.second.global_pin == global;
-						  }) != m_pin_channels.end();
-	if(exists) {
-		m_embedded->closeIOF(global);
-		erase_if(m_pin_channels, [global](const auto& pin_pair){
-			return pin_pair.second.global_pin == global;
-		});
-	}
-	m_writing_connections.remove_if([global](const PinMapping& mapping){return mapping.global_pin == global;});
-	m_reading_connections.remove_if([global](const PinMapping& mapping){return mapping.global_pin == global;});
+	m_circuit.removePin(global);
 	if(!keep_on_raster) {
 		removePinFromRaster(global);
 	}
 	updateOverlay();
 }
 
-void Breadboard::removePinForDevice(gpio::PinNumber global, const DeviceID& device_id) {
-	auto req = m_pin_channels.find(device_id);
-	if(req != m_pin_channels.end() && req->second.global_pin == global) {
-		m_embedded->closeIOF(global);
-		m_pin_channels.erase(device_id);
-	}
-	m_writing_connections.remove_if([global,device_id](const PinMapping& mapping){
-		return mapping.device == device_id && mapping.global_pin == global;
-	});
-	m_reading_connections.remove_if([global, device_id](const PinMapping& mapping){
-		return mapping.device == device_id && mapping.global_pin == global;
-	});
-}
-
 void Breadboard::removePinFromRaster(gpio::PinNumber global) {
 	for(auto& [row, content] : m_raster) {
 		content.pins.remove_if([global](const PinConnection& c_obj){return c_obj.global_pin == global;});
 	}
+	update();
 }
 
 void Breadboard::removeConnections(gpio::PinNumber global, bool keep_on_raster) {
@@ -379,29 +145,32 @@ void Breadboard::removeConnections(gpio::PinNumber global, bool keep_on_raster)
 }
 
 void Breadboard::removeDevice(const DeviceID& id) {
-	if(m_pin_channels.contains(id)) removePinForDevice(m_pin_channels.find(id)->second.global_pin, id);
-	if(m_spi_channels.contains(id)) removeSPIForDevice(m_spi_channels.find(id)->second.global_pin, id);
-	m_writing_connections.remove_if([id](const PinMapping& mapping){return mapping.device == id;});
-	m_reading_connections.remove_if([id](const PinMapping& mapping){return mapping.device == id;});
+	m_circuit.removeDevice(id);
 	for(auto& [row, content] : m_raster) {
 		content.devices.remove_if([id](const DeviceConnection& c_obj){return c_obj.id == id;});
 	}
-	m_devices.erase(id);
+	m_scheduled_generation.erase(id);
+	m_render_cache.erase(id);
+	if(m_shm) {
+		m_shm->removeDevice(id);
+	}
+	update();
+}
+
+void Breadboard::exportSharedMemory(const string& prefix) {
+	m_shm = make_unique<ShmExport>(prefix);
 }
 
 void Breadboard::clear() {
-	for(const auto& [id,spi] : m_spi_channels) {
-		m_embedded->closeIOF(spi.global_pin);
-	}
-	for(const auto& [id,pin] : m_pin_channels) {
-		m_embedded->closeIOF(pin.global_pin);
+	if(m_shm) {
+		for(const auto& [id, device] : m_circuit.getDevices()) {
+			m_shm->removeDevice(id);
+		}
 	}
-	m_spi_channels.clear();
-	m_pin_channels.clear();
-	m_writing_connections.clear();
-	m_reading_connections.clear();
+	m_circuit.clear();
 	m_raster.clear();
-	m_devices.clear();
+	m_scheduled_generation.clear();
+	m_render_cache.clear();
 
 	updateOverlay();
 
@@ -411,52 +180,10 @@ void Breadboard::clear() {
 
 /* Update */
 
-void Breadboard::timerUpdate(Embedded::PinRegister state) {
-	m_lua_access.lock();
-	for(const auto& mapping : m_reading_connections) {
-		auto device = m_devices.find(mapping.device);
-		if(device == m_devices.end()) {
-			removeDevice(mapping.device);
-			continue;
-		}
-		if(!device->second->m_pin) continue;
-		device->second->m_pin->setPin(mapping.device_pin, ((state >> mapping.global_pin)&1 ? gpio::Tristate::HIGH : gpio::Tristate::LOW));
-	}
-	for(const auto& mapping : m_writing_connections) {
-		auto device = m_devices.find(mapping.device);
-		if(device == m_devices.end()) {
-			removeDevice(mapping.device);
-			continue;
-		}
-		if(!device->second->m_pin) continue;
-		m_embedded->setBit(mapping.global_pin, device->second->m_pin->getPin(mapping.device_pin));
-	}
-	m_lua_access.unlock();
+void Breadboard::pinsChanged(Board::PinRegister state, Board::PinRegister changed) {
+	m_circuit.pinsChanged(state, changed);
 }
 
 void Breadboard::connectionUpdate(bool active) {
-	if(active) {
-		for(const auto& [id, req] : m_spi_channels) {
-			m_embedded->registerIOF_SPI(req.global_pin, req.fun, req.noresponse);
-		}
-		for(const auto& [id, req] : m_pin_channels) {
-			m_embedded->registerIOF_PIN(req.global_pin, req.fun);
-		}
-	}
-	// else connection lost
-}
-
-void Breadboard::writeDevice(const DeviceID& id) {
-	auto device = m_devices.find(id);
-	if(device == m_devices.end()) {
-		removeDevice(id);
-		return;
-	}
-	if(!device->second->m_pin) return;
-	m_lua_access.lock();
-	for(const auto& mapping : m_writing_connections) {
-		if(mapping.device != id) continue;
-		m_embedded->setBit(mapping.global_pin, device->second->m_pin->getPin(mapping.device_pin));
-	}
-	m_lua_access.unlock();
+	m_circuit.connectionUpdate(active);
 }
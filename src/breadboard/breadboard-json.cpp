@@ -41,65 +41,26 @@ void Breadboard::fromJSON(QJsonObject json) {
 
 	if(json.contains("devices") && json["devices"].isArray()) {
 		QJsonArray device_descriptions = json["devices"].toArray();
-		m_devices.reserve(device_descriptions.count());
-		if(debug_logging)
-			cout << "[Breadboard] reserving space for " << device_descriptions.count() << " devices." << endl;
 		for(const auto& device_description : device_descriptions) {
-			QJsonObject device_desc = device_description.toObject();
-			if(!device_desc.contains("id") || !device_desc["id"].isString() || !device_desc.contains("graphics") || !device_desc["graphics"].isObject()) {
-				cerr << "[Breadboard] Config misses information/malformed for a device" << endl;
+			Circuit::DeviceDescription device_desc;
+			if(!Circuit::parseDevice(device_description.toObject(), device_desc)) {
 				continue;
 			}
-			const string& classname = device_desc["class"].toString("undefined").toStdString();
-			const string& id = device_desc["id"].toString().toStdString();
-			QJsonObject graphics = device_desc["graphics"].toObject();
-			if(!graphics.contains("offs") || !graphics["offs"].isArray()) {
-				cerr << "[Breadboard] Config misses position of a device" << endl;
+			if(!addDevice(device_desc.classname, getDistortedPosition(device_desc.offs), device_desc.id)) {
+				cerr << "[Breadboard] could not create device '" << device_desc.classname << "'." << endl;
 				continue;
 			}
-			const QJsonArray offs_desc = graphics["offs"].toArray();
-			if(offs_desc.size() != 2) {
-				cerr << "[Breadboard] Config misses position of a device" << endl;
-				continue;
-			}
-			QPoint offs(offs_desc[0].toInt(), offs_desc[1].toInt());
+			m_circuit.deviceFromJSON(device_desc.id, device_desc.json);
 
-			if(!addDevice(classname, getDistortedPosition(offs), id)) {
-				cerr << "[Breadboard] could not create device '" << classname << "'." << endl;
-				continue;
-			}
-			auto device = m_devices.find(id);
-			if(device == m_devices.end()) continue;
-
-			m_lua_access.lock();
-			device->second->fromJSON(device_desc);
-			m_lua_access.unlock();
-
-			if(device_desc.contains("pins") && device_desc["pins"].isArray()) {
-				QJsonArray device_connections = device_desc["pins"].toArray();
-				for(const auto& device_connection : device_connections) {
-					QJsonObject connection_obj = device_connection.toObject();
-					if(!connection_obj.contains("device_pin") || !connection_obj.contains("global_pin")) {
-						cerr << "[Breadboard] JSON entry for a connection is missing device pin or global pin" << endl;
-						continue;
-					}
-					gpio::PinNumber global = connection_obj["global_pin"].toInt();
-					Device::PIN_Interface::DevicePin device_pin = connection_obj["device_pin"].toInt();
-					string name = connection_obj["name"].toString("undefined").toStdString();
-					bool sync = connection_obj["synchronous"].toBool(false);
-					addPinToDevicePin(id, device_pin, global, name);
-					if(sync) setPinSync(global, device_pin, id, true);
-					if(connection_obj.contains("spi_noresponse") && connection_obj["spi_noresponse"].isBool()) {
-						setSPInoresponse(global, connection_obj["spi_noresponse"].toBool());
-					}
-				}
+			for(const auto& connection : device_desc.connections) {
+				addPinToDevicePin(device_desc.id, connection.device_pin, connection.global_pin, connection.name);
+				m_circuit.setConnectionOptions(device_desc.id, connection);
 			}
 		}
 
 		if(debug_logging) {
 			cout << "Instatiated devices:" << endl;
-			m_lua_access.lock();
-			for (auto& [id, device] : m_devices) {
+			for (auto& [id, device] : m_circuit.getDevices()) {
 				cout << "\t" << id << " of class " << device->getClass() << endl;
 				cout << "\t minimum buffer size " << device->getBuffer().width() << "x" << device->getBuffer().height() << " pixel." << endl;
 
@@ -110,7 +71,6 @@ void Breadboard::fromJSON(QJsonObject json) {
 				if(device->m_conf)
 					cout << "\t\timplements conf" << endl;
 			}
-			m_lua_access.unlock();
 
 			printConnections();
 		}
@@ -129,23 +89,21 @@ QJsonObject Breadboard::toJSON() {
 		current_state["window"] = window;
 	}
 	QJsonArray devices_json;
-	for(const auto& [id, device] : m_devices) {
-		m_lua_access.lock();
+	for(const auto& [id, device] : m_circuit.getDevices()) {
+		device->m_access.lock();
 		QJsonObject dev_json = device->toJSON();
-		m_lua_access.unlock();
-		unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber> pins = getPinsToDevicePins(id);
+		device->m_access.unlock();
+		unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber> pins = m_circuit.getPinsToDevicePins(id);
 		QJsonArray pins_json;
-		auto sync_pin = m_pin_channels.find(id);
+		auto sync_pin = m_circuit.getSyncPin(id);
 		for(const auto& [device_pin, global] : pins) {
-			if(!m_embedded->isPin(global)) continue;
-			QJsonObject pin_json;
-			pin_json["global_pin"] = global;
-			pin_json["device_pin"] = (int) device_pin;
-			pin_json["name"] = QString::fromStdString(getPinName(global));
-			if(sync_pin!=m_pin_channels.end() && sync_pin->second.global_pin==global) {
-				pin_json["synchronous"] = true;
-			}
-			pins_json.append(pin_json);
+			if(!m_embedded->getBoard().isPin(global)) continue;
+			pins_json.append(Circuit::connectionToJSON(Circuit::ConnectionDescription{
+				.global_pin = global,
+				.device_pin = device_pin,
+				.name = getPinName(global),
+				.synchronous = sync_pin && sync_pin->second == global
+			}));
 		}
 		dev_json["pins"] = pins_json;
 		devices_json.append(dev_json);
@@ -14,28 +14,32 @@ void Breadboard::keyPressEvent(QKeyEvent *e) {
 		switch (e->key()) {
 		case Qt::Key_0: {
 			uint8_t until = 6;
+			PinWrite pins;
 			for (uint8_t i = 0; i < 8; i++) {
-				m_embedded->setBit(i, i < until ? gpio::Tristate::HIGH : gpio::Tristate::LOW);
+				pins.set(i, i < until ? gpio::Tristate::HIGH : gpio::Tristate::LOW);
 			}
+			m_embedded->getBoard().setBits(pins);
 			break;
 		}
 		case Qt::Key_1: {
+			PinWrite pins;
 			for (uint8_t i = 0; i < 8; i++) {
-				m_embedded->setBit(i, gpio::Tristate::LOW);
+				pins.set(i, gpio::Tristate::LOW);
 			}
+			m_embedded->getBoard().setBits(pins);
 			break;
 		}
 		default:
-			for(const auto& [id, device] : m_devices) {
+			for(const auto& [id, device] : m_circuit.getDevices()) {
 				if(device->m_input) {
-					m_lua_access.lock();
+					device->m_access.lock();
 					Keys device_keys = device->m_input->getKeys();
-					m_lua_access.unlock();
+					device->m_access.unlock();
 					if(device_keys.find(e->key()) != device_keys.end()) {
-						m_lua_access.lock();
+						device->m_access.lock();
 						device->m_input->onKeypress(e->key(), true);
-						m_lua_access.unlock();
-						writeDevice(id);
+						device->m_access.unlock();
+						m_circuit.writeDevice(id);
 					}
 				}
 			}
@@ -48,16 +52,16 @@ void Breadboard::keyPressEvent(QKeyEvent *e) {
 void Breadboard::keyReleaseEvent(QKeyEvent *e)
 {
 	if(!m_debugmode) {
-		for(const auto& [id, device] : m_devices) {
+		for(const auto& [id, device] : m_circuit.getDevices()) {
 			if(device->m_input) {
-				m_lua_access.lock();
+				device->m_access.lock();
 				Keys device_keys = device->m_input->getKeys();
-				m_lua_access.unlock();
+				device->m_access.unlock();
 				if(device_keys.find(e->key()) != device_keys.end()) {
-					m_lua_access.lock();
+					device->m_access.lock();
 					device->m_input->onKeypress(e->key(), false);
-					m_lua_access.unlock();
-					writeDevice(id);
+					device->m_access.unlock();
+					m_circuit.writeDevice(id);
 				}
 			}
 		}
@@ -66,11 +70,11 @@ void Breadboard::keyReleaseEvent(QKeyEvent *e)
 }
 
 void Breadboard::mousePressEvent(QMouseEvent *e) {
-	for(const auto& [id, device] : m_devices) {
-		m_lua_access.lock();
+	for(const auto& [id, device] : m_circuit.getDevices()) {
+		device->m_access.lock();
 		QImage buffer = device->getBuffer();
 		unsigned scale = device->getScale();
-		m_lua_access.unlock();
+		device->m_access.unlock();
 		if(!scale) scale = 1;
 		QRect buffer_bounds = getDistortedGraphicBounds(buffer, scale);
 		if(buffer_bounds.contains(e->pos()) && e->button() == Qt::LeftButton)  {
@@ -94,10 +98,10 @@ void Breadboard::mousePressEvent(QMouseEvent *e) {
 			}
 			else { // Input
 				if(device->m_input) {
-					m_lua_access.lock();
+					device->m_access.lock();
 					device->m_input->onClick(true);
-					m_lua_access.unlock();
-					writeDevice(id);
+					device->m_access.unlock();
+					m_circuit.writeDevice(id);
 				}
 			}
 			return;
@@ -107,14 +111,14 @@ void Breadboard::mousePressEvent(QMouseEvent *e) {
 }
 
 void Breadboard::mouseReleaseEvent(QMouseEvent *e) {
-	for(const auto& [id, device] : m_devices) {
+	for(const auto& [id, device] : m_circuit.getDevices()) {
 		if(e->button() == Qt::LeftButton) {
 			if(!m_debugmode) {
 				if(device->m_input) {
-					m_lua_access.lock();
+					device->m_access.lock();
 					device->m_input->onClick(false);
-					m_lua_access.unlock();
-					writeDevice(id);
+					device->m_access.unlock();
+					m_circuit.writeDevice(id);
 				}
 			}
 		}
@@ -124,19 +128,27 @@ void Breadboard::mouseReleaseEvent(QMouseEvent *e) {
 
 void Breadboard::mouseMoveEvent(QMouseEvent *e) {
 	bool device_hit = false;
-	m_lua_access.lock();
-	for(const auto& [id, device] : m_devices) {
+	for(const auto& [id, device] : m_circuit.getDevices()) {
+		device->m_access.lock();
 		QRect device_bounds = getDistortedGraphicBounds(device->getBuffer(), device->getScale());
+		device->m_access.unlock();
 		if(device_bounds.contains(e->pos())) {
 			QCursor current_cursor = cursor();
 			current_cursor.setShape(Qt::PointingHandCursor);
 			setCursor(current_cursor);
 			string tooltip = "<b>"+device->getClass()+"</b><br><\br>"+id;
+			if(m_debugmode) {
+				device->m_access.lock();
+				const string statistics = device->getStatistics();
+				device->m_access.unlock();
+				if(!statistics.empty()) {
+					tooltip += "<br>"+statistics;
+				}
+			}
 			QToolTip::showText(mapToGlobal(e->pos()), QString::fromStdString(tooltip), this, device_bounds);
 			device_hit = true;
 		}
 	}
-	m_lua_access.unlock();
 	if(!device_hit) {
 		QCursor current_cursor = cursor();
 		current_cursor.setShape(Qt::ArrowCursor);
@@ -191,6 +203,7 @@ void Breadboard::dropEvent(QDropEvent *e) {
 		if(isValidRasterRow(row) && isValidRasterIndex(index)) {
 			addPinToRow(row, index, pin, "cable");
 			updateOverlay();
+			update();
 			e->acceptProposedAction();
 		}
 		else {
@@ -235,19 +248,42 @@ void Breadboard::updateOverlay() {
 	m_overlay->update();
 }
 
-void Breadboard::paintEvent(QPaintEvent*) {
+void Breadboard::scheduleDamagedDevices() {
+	if(m_shm) {
+		m_shm->publishPins(m_embedded->getBoard().getState());
+	}
+	for(const auto& [id, device] : m_circuit.getDevices()) {
+		device->flushSPI();
+		if(m_shm) {
+			m_shm->publishDevice(id, *device);
+		}
+		const uint64_t generation = device->getGeneration();
+		auto scheduled = m_scheduled_generation.find(id);
+		if(scheduled != m_scheduled_generation.end() && scheduled->second == generation) continue;
+		m_scheduled_generation[id] = generation;
+		device->m_access.lock();
+		const QRect graphic_bounds = getDistortedGraphicBounds(device->getBuffer(), device->getScale());
+		device->m_access.unlock();
+		update(graphic_bounds);
+	}
+}
+
+void Breadboard::paintEvent(QPaintEvent* e) {
 	QPainter painter(this);
 	painter.setRenderHint(QPainter::Antialiasing);
+	const QRect damaged = e->rect();
 
 	if(isBreadboard()) {
 		painter.save();
 		QColor dark("#101010");
 		dark.setAlphaF(0.5);
 		painter.setBrush(QBrush(dark));
+		const QSize pin_size = getDistortedSize(QSize(iconSizeMinimum(),iconSizeMinimum()));
 		for(Row row=0; row<BB_ROWS; row++) {
 			for(Index index=0; index<BB_INDEXES; index++) {
-				painter.drawRect(QRect(getAbsolutePosition(row,index),
-						getDistortedSize(QSize(iconSizeMinimum(),iconSizeMinimum()))));
+				const QRect pin_rect(getAbsolutePosition(row,index), pin_size);
+				if(!pin_rect.intersects(damaged)) continue;
+				painter.drawRect(pin_rect);
 			}
 		}
 		QColor red("red");
@@ -255,8 +291,9 @@ void Breadboard::paintEvent(QPaintEvent*) {
 		painter.setBrush(QBrush(red));
 		for(const auto& [row, content] : m_raster) {
 			for(const auto& pin : content.pins) {
-				painter.drawRect(QRect(getAbsolutePosition(row, pin.index),
-									   getDistortedSize(QSize(iconSizeMinimum(), iconSizeMinimum()))));
+				const QRect pin_rect(getAbsolutePosition(row, pin.index), pin_size);
+				if(!pin_rect.intersects(damaged)) continue;
+				painter.drawRect(pin_rect);
 			}
 		}
 		painter.restore();
@@ -269,16 +306,24 @@ void Breadboard::paintEvent(QPaintEvent*) {
 	}
 
 	// Graph Buffers
-	m_lua_access.lock();
-	for (auto& [id, device] : m_devices) {
+	for (auto& [id, device] : m_circuit.getDevices()) {
+		device->m_access.lock();
+		const uint64_t generation = device->getGeneration();
 		QImage buffer = device->getBuffer();
-		QRect graphic_bounds = getDistortedGraphicBounds(buffer, device->getScale());
-		painter.drawImage(graphic_bounds.topLeft(), buffer.scaled(graphic_bounds.size()));
+		const unsigned scale = device->getScale();
+		device->m_access.unlock();
+		QRect graphic_bounds = getDistortedGraphicBounds(buffer, scale);
+		if(!graphic_bounds.intersects(damaged)) continue;
+		RenderCache& cache = m_render_cache[id];
+		if(cache.pixmap.isNull() || cache.generation != generation || cache.pixmap.size() != graphic_bounds.size()) {
+			cache.generation = generation;
+			cache.pixmap = QPixmap::fromImage(buffer.scaled(graphic_bounds.size()));
+		}
+		painter.drawPixmap(graphic_bounds.topLeft(), cache.pixmap);
 		if(m_debugmode) {
 			painter.drawRect(graphic_bounds);
 		}
 	}
-	m_lua_access.unlock();
 
 	painter.end();
 }
@@ -5,13 +5,14 @@
 
 using namespace std;
 
-Breadboard::Breadboard() : QWidget() {
+Breadboard::Breadboard(Factory& factory, Embedded *embedded) : QWidget(), m_embedded(embedded),
+		m_factory(factory), m_circuit(factory, embedded->getBoard()) {
 	setFocusPolicy(Qt::StrongFocus);
 	setAcceptDrops(true);
 	setMouseTracking(true);
 
 	auto *timer = new QTimer(this);
-	connect(timer, &QTimer::timeout, this, [this]{update();});
+	connect(timer, &QTimer::timeout, this, &Breadboard::scheduleDamagedDevices);
 	timer->start(1000/30);
 
 	setContextMenuPolicy(Qt::CustomContextMenu);
@@ -57,13 +58,10 @@ Breadboard::~Breadboard() = default;
 bool Breadboard::isBreadboard() { return m_bkgnd_path == DEFAULT_PATH; }
 bool Breadboard::toggleDebug() {
 	m_debugmode = !m_debugmode;
+	update();
 	return m_debugmode;
 }
 
-void Breadboard::setEmbedded(Embedded *embedded) {
-	this->m_embedded = embedded;
-}
-
 void Breadboard::setOverlay(Overlay *overlay) {
 	this->m_overlay = overlay;
 }
@@ -91,12 +89,12 @@ QPoint Breadboard::checkDevicePosition(const DeviceID& id, const QImage& buffer,
 		return {-1,-1};
 	}
 
-	for(const auto& [id_it, device_it] : m_devices) {
+	for(const auto& [id_it, device_it] : m_circuit.getDevices()) {
 		if(id_it == id) continue;
-		m_lua_access.lock();
+		device_it->m_access.lock();
 		auto current_buffer = device_it->getBuffer();
 		auto current_scale = device_it->getScale();
-		m_lua_access.unlock();
+		device_it->m_access.unlock();
 		if(getDistortedGraphicBounds(current_buffer,
 				current_scale).intersects(device_bounds)) {
 			cerr << "[Breadboard] Device position invalid: Overlaps with other device." << endl;
@@ -107,13 +105,13 @@ QPoint Breadboard::checkDevicePosition(const DeviceID& id, const QImage& buffer,
 }
 
 bool Breadboard::moveDevice(const DeviceID& device_id, QPoint position, QPoint hotspot) {
-	auto device = m_devices.find(device_id);
-	if(device == m_devices.end()) return false;
-	m_lua_access.lock();
-	unsigned scale = device->second->getScale();
+	Device* device = m_circuit.getDevice(device_id);
+	if(!device) return false;
+	device->m_access.lock();
+	unsigned scale = device->getScale();
 	if(!scale) scale = 1;
-	auto buffer = device->second->getBuffer();
-	m_lua_access.unlock();
+	auto buffer = device->getBuffer();
+	device->m_access.unlock();
 	QPoint upper_left = checkDevicePosition(device_id, buffer, scale, position, hotspot);
 
 	if(upper_left.x()<0) {
@@ -121,17 +119,17 @@ bool Breadboard::moveDevice(const DeviceID& device_id, QPoint position, QPoint h
 		return false;
 	}
 
-	m_lua_access.lock();
-	device->second->getBuffer().setOffset(upper_left);
-	device->second->setScale(scale);
-	m_lua_access.unlock();
+	device->m_access.lock();
+	device->getBuffer().setOffset(upper_left);
+	device->setScale(scale);
+	device->m_access.unlock();
 
-	if(!device->second->m_pin) {
+	if(!device->m_pin) {
 		return true;
 	}
-	m_lua_access.lock();
-	Device::PIN_Interface::PinLayout device_layout = device->second->m_pin->getPinLayout();
-	m_lua_access.unlock();
+	device->m_access.lock();
+	Device::PIN_Interface::PinLayout device_layout = device->m_pin->getPinLayout();
+	device->m_access.unlock();
 	for(const auto& [device_pin, desc] : device_layout) {
 		Row old_row = getRowForDevicePin(device_id, device_pin);
 		Row new_row;
@@ -141,8 +139,8 @@ bool Breadboard::moveDevice(const DeviceID& device_id, QPoint position, QPoint h
 				if(old_row_obj!=m_raster.end()) {
 					old_row_obj->second.devices.remove_if([device_id](const DeviceConnection& c){return c.id == device_id;});
 					for(const auto& pin : old_row_obj->second.pins) {
-						removePinForDevice(pin.global_pin, device_id);
-						removeSPIForDevice(pin.global_pin, device_id);
+						m_circuit.removePinForDevice(pin.global_pin, device_id);
+						m_circuit.removeSPIForDevice(pin.global_pin, device_id);
 					}
 				}
 			}
@@ -173,45 +171,17 @@ bool Breadboard::moveDevice(const DeviceID& device_id, QPoint position, QPoint h
 		}
 		createRowConnections(new_row);
 	}
+	update();
 	return true;
 }
 
 bool Breadboard::addDevice(const DeviceClass& classname, QPoint pos, DeviceID id) {
 	if(id.empty()) {
-		std::set<unsigned> used_ids;
-		for(const auto& [id_it, device_it] : m_devices) {
-			if(find_if(id_it.begin(), id_it.end(), [](unsigned char c){return !isdigit(c);}) == id_it.end()) {
-				used_ids.insert(stoi(id_it));
-			}
-		}
-		unsigned id_int = 0;
-		for(unsigned used_id : used_ids) {
-			if(used_id > id_int)
-				break;
-			id_int++;
-		}
-		id = std::to_string(id_int);
+		id = m_circuit.getNewDeviceID();
 	}
-
-	if(id.empty()) {
-		cerr << "[Breadboard] Device ID cannot be empty string!" << endl;
+	if(!m_circuit.addDevice(id, classname, iconSizeMinimum(), pos)) {
 		return false;
 	}
-	if(!m_factory.deviceExists(classname)) {
-		cerr << "[Breadboard] Class name '" << classname << "' invalid." << endl;
-		return false;
-	}
-	if(m_devices.find(id) != m_devices.end()) {
-		cerr << "[Breadboard] Another device with the ID '" << id << "' already exists!" << endl;
-		return false;
-	}
-
-	unique_ptr<Device> device = m_factory.instantiateDevice(id, classname);
-	m_lua_access.lock();
-	device->createBuffer(iconSizeMinimum(), pos);
-	m_lua_access.unlock();
-
-	m_devices.insert(make_pair(id, std::move(device)));
 
 	if(!moveDevice(id, pos)) {
 		cerr << "[Breadboard] Could not place new " << classname << " device" << endl;
@@ -224,16 +194,16 @@ bool Breadboard::addDevice(const DeviceClass& classname, QPoint pos, DeviceID id
 /* Context Menu */
 
 void Breadboard::openContextMenu(QPoint pos) {
-	m_lua_access.lock();
-	for(const auto& [id, device] : m_devices) {
-		if(getDistortedGraphicBounds(device->getBuffer(), device->getScale()).contains(pos)) {
+	for(const auto& [id, device] : m_circuit.getDevices()) {
+		device->m_access.lock();
+		const bool hit = getDistortedGraphicBounds(device->getBuffer(), device->getScale()).contains(pos);
+		device->m_access.unlock();
+		if(hit) {
 			m_menu_device_id = id;
 			m_devices_menu->popup(mapToGlobal(pos));
-			m_lua_access.unlock();
 			return;
 		}
 	}
-	m_lua_access.unlock();
 	if(isBreadboard()) {
 		for(const auto& [row, content] : m_raster) {
 			for(const auto& pin : content.pins) {
@@ -261,49 +231,50 @@ void Breadboard::removeActiveDevice() {
 }
 
 void Breadboard::scaleActiveDevice() {
-	auto device = m_devices.find(m_menu_device_id);
-	if(device == m_devices.end()) {
+	Device* device = m_circuit.getDevice(m_menu_device_id);
+	if(!device) {
 		m_error_dialog->showMessage("Could not find device");
 		return;
 	}
 	bool ok;
-	m_lua_access.lock();
-	auto old_scale = device->second->getScale();
-	m_lua_access.unlock();
+	device->m_access.lock();
+	auto old_scale = device->getScale();
+	device->m_access.unlock();
 	int scale = QInputDialog::getInt(this, "Input new scale value", "Scale",
 									 old_scale, 1, 10, 1, &ok);
-	m_lua_access.lock();
-	auto buffer = device->second->getBuffer();
-	m_lua_access.unlock();
+	device->m_access.lock();
+	auto buffer = device->getBuffer();
+	device->m_access.unlock();
 	if(ok && checkDevicePosition(m_menu_device_id, buffer,
 								 scale, getDistortedPosition(buffer.offset())).x()>=0) {
-		m_lua_access.lock();
-		device->second->setScale(scale);
-		m_lua_access.unlock();
+		device->m_access.lock();
+		device->setScale(scale);
+		device->m_access.unlock();
+		update();
 	}
 	m_menu_device_id = "";
 }
 
 void Breadboard::openDeviceConfiguration() {
-	auto device = m_devices.find(m_menu_device_id);
-	if(device == m_devices.end()) {
+	Device* device = m_circuit.getDevice(m_menu_device_id);
+	if(!device) {
 		m_error_dialog->showMessage("Could not find device");
 		m_menu_device_id = "";
 		return;
 	}
-	m_lua_access.lock();
-	if(device->second->m_conf) m_device_configuration->setConfig(m_menu_device_id, device->second->m_conf->getConfig());
+	device->m_access.lock();
+	if(device->m_conf) m_device_configuration->setConfig(m_menu_device_id, device->m_conf->getConfig());
 	else m_device_configuration->hideConfig();
-	if(device->second->m_input) m_device_configuration->setKeys(m_menu_device_id, device->second->m_input->getKeys());
+	if(device->m_input) m_device_configuration->setKeys(m_menu_device_id, device->m_input->getKeys());
 	else m_device_configuration->hideKeys();
-	m_lua_access.unlock();
-	if(device->second->m_pin) {
+	device->m_access.unlock();
+	if(device->m_pin) {
 		Device::PIN_Interface::DevicePin sync = numeric_limits<Device::PIN_Interface::DevicePin>::max();
-		auto sync_pin = m_pin_channels.find(m_menu_device_id);
-		if(sync_pin != m_pin_channels.end()) {
-			sync = sync_pin->second.device_pin;
+		auto sync_pin = m_circuit.getSyncPin(m_menu_device_id);
+		if(sync_pin) {
+			sync = sync_pin->first;
 		}
-		m_device_configuration->setPins(m_menu_device_id, getPinsToDevicePins(m_menu_device_id), sync);
+		m_device_configuration->setPins(m_menu_device_id, m_circuit.getPinsToDevicePins(m_menu_device_id), sync);
 	}
 	else {
 		m_device_configuration->hidePins();
@@ -314,35 +285,37 @@ void Breadboard::openDeviceConfiguration() {
 }
 
 void Breadboard::updateKeybinding(const DeviceID& device_id, Keys keys) {
-	auto device = m_devices.find(device_id);
-	if(device == m_devices.end() || !device->second->m_input) {
+	Device* device = m_circuit.getDevice(device_id);
+	if(!device || !device->m_input) {
 		m_error_dialog->showMessage("Device does not implement input interface.");
 		return;
 	}
-	m_lua_access.lock();
-	device->second->m_input->setKeys(keys);
-	m_lua_access.unlock();
+	device->m_access.lock();
+	device->m_input->setKeys(keys);
+	device->m_access.unlock();
 }
 
 void Breadboard::updateConfig(const DeviceID& device_id, Config config) {
-	auto device = m_devices.find(device_id);
-	if(device == m_devices.end() || !device->second->m_conf) {
+	Device* device = m_circuit.getDevice(device_id);
+	if(!device || !device->m_conf) {
 		m_error_dialog->showMessage("Device does not implement config interface.");
 		return;
 	}
-	m_lua_access.lock();
-	device->second->m_conf->setConfig(config);
-	m_lua_access.unlock();
+	device->m_access.lock();
+	device->m_conf->setConfig(config);
+	device->m_access.unlock();
+	// the config may change what the device drives on its output pins
+	m_circuit.writeDevice(device_id);
 }
 
 void Breadboard::updatePins(const DeviceID &device_id, const unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber>& globals, PinDialog::ChangedSync sync) {
 	for(const auto& [device_pin, global] : globals) {
 		addPinToDevicePin(device_id, device_pin, global, "dialog");
 	}
-	unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber> device_pins = getPinsToDevicePins(device_id);
+	unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber> device_pins = m_circuit.getPinsToDevicePins(device_id);
 	auto sync_pin = device_pins.find(sync.first);
 	if(sync_pin != device_pins.end()) {
-		setPinSync(sync_pin->second, sync.first, device_id, sync.second);
+		m_circuit.setPinSync(sync_pin->second, sync.first, device_id, sync.second);
 	}
 	updateOverlay();
 	// TODO update dialog content?
@@ -6,6 +6,8 @@
 
 #include <factory/factory.h>
 #include <embedded.h>
+#include <circuit.h>
+#include <shm-export.h>
 
 #include <QWidget>
 #include <QMouseEvent>
@@ -17,7 +19,6 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <list>
-#include <mutex> // TODO: FIXME: Create one Lua state per device that uses asyncs like SPI and synchronous pins
 
 class Breadboard : public QWidget {
 	Q_OBJECT
@@ -28,25 +29,6 @@ class Breadboard : public QWidget {
 	typedef unsigned Row;
 	typedef unsigned Index;
 
-	struct SPI_IOF_Request {
-		gpio::PinNumber global_pin;
-		Device::PIN_Interface::DevicePin cs_pin;
-		bool noresponse;
-		GpioClient::OnChange_SPI fun;
-	};
-
-	struct PIN_IOF_Request {
-		gpio::PinNumber global_pin;
-		Device::PIN_Interface::DevicePin device_pin;
-		GpioClient::OnChange_PIN fun;
-	};
-
-	struct PinMapping {
-		gpio::PinNumber global_pin;
-		Device::PIN_Interface::DevicePin device_pin;
-		DeviceID device;
-	};
-
 	struct PinConnection {
 		gpio::PinNumber global_pin;
 		std::string name;
@@ -63,17 +45,20 @@ class Breadboard : public QWidget {
 		std::list<PinConnection> pins;
 	};
 
-	std::mutex m_lua_access;		//TODO: Use multiple Lua states per 'async called' device
-	Factory m_factory;
-	std::unordered_map<DeviceID,std::unique_ptr<Device>> m_devices;
-
-	std::unordered_map<DeviceID,SPI_IOF_Request> m_spi_channels;
-	std::unordered_map<DeviceID,PIN_IOF_Request> m_pin_channels;
-	std::list<PinMapping> m_reading_connections;
-	std::list<PinMapping> m_writing_connections;
+	Factory& m_factory;
+	Circuit m_circuit;	// devices and their connections, the raster only places them
 
 	std::unordered_map<Row,RowContent> m_raster;
 
+	struct RenderCache {
+		uint64_t generation = 0;
+		QPixmap pixmap;		// scaled to the device's bounds on the widget
+	};
+
+	std::unordered_map<DeviceID,uint64_t> m_scheduled_generation;	// last device content a repaint was scheduled for
+	std::unordered_map<DeviceID,RenderCache> m_render_cache;
+	std::unique_ptr<ShmExport> m_shm;	// only with exportSharedMemory
+
 	bool m_debugmode = false;
 	QString m_bkgnd_path;
 	QPixmap m_bkgnd;
@@ -99,22 +84,12 @@ class Breadboard : public QWidget {
 	void addPinToRow(Row row, Index index, gpio::PinNumber global, std::string name);
 	void addPinToRowContent(Row row, Index index, gpio::PinNumber global, std::string name);
 	void createRowConnections(Row row);
-	std::unordered_set<gpio::PinNumber> getPinsToDevice(const DeviceID& device_id);
-	std::unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber> getPinsToDevicePins(const DeviceID& device_id);
-	void registerPin(gpio::PinNumber global, Device::PIN_Interface::DevicePin device_pin, const DeviceID& device_id, bool synchronous=false);
-	void setPinSync(gpio::PinNumber global, Device::PIN_Interface::DevicePin device_pin, const DeviceID& device_id, bool synchronous);
-	void registerSPI(gpio::PinNumber global, Device::PIN_Interface::DevicePin cs_pin, const DeviceID& device_id, bool noresponse);
-	void setSPInoresponse(gpio::PinNumber global, bool noresponse);
 	Row removeConnection(const DeviceID& device_id, Device::PIN_Interface::DevicePin device_pin);
 	void removeConnections(gpio::PinNumber global, bool keep_on_raster);
 	void removeSPI(gpio::PinNumber global, bool keep_on_raster);
-	void removeSPIForDevice(gpio::PinNumber global, const DeviceID& device_id);
 	void removePin(gpio::PinNumber global, bool keep_on_raster);
-	void removePinForDevice(gpio::PinNumber global, const DeviceID& device_id);
 	void removePinFromRaster(gpio::PinNumber global);
 
-	void writeDevice(const DeviceID& id);
-
 	// Drag and Drop
 	QPoint checkDevicePosition(const DeviceID& id, const QImage& buffer, int scale, QPoint position, QPoint hotspot=QPoint(0,0));
 	bool moveDevice(const DeviceID& device_id, QPoint position, QPoint hotspot=QPoint(0,0));
@@ -123,6 +98,7 @@ class Breadboard : public QWidget {
 	void dragMoveEvent(QDragMoveEvent *e) override;
 
 	// QT
+	void scheduleDamagedDevices();
 	void paintEvent(QPaintEvent *e) override;
 	void keyPressEvent(QKeyEvent *e) override;
 	void keyReleaseEvent(QKeyEvent *e) override;
@@ -159,12 +135,11 @@ class Breadboard : public QWidget {
 	QPoint getMinimumPosition(QPoint pos);
 
 public:
-	Breadboard();
+	Breadboard(Factory& factory, Embedded *embedded);
 	~Breadboard();
 
 	bool toggleDebug();
 
-	void setEmbedded(Embedded *embedded);
 	void setOverlay(Overlay *overlay);
 	void updateOverlay();
 
@@ -173,9 +148,9 @@ public:
 	QJsonObject toJSON();
 	void additionalLuaDir(const std::string& additional_device_dir, bool overwrite_integrated_devices);
 	void clear();
+	void exportSharedMemory(const std::string& prefix);
 
 	// GPIO
-	void timerUpdate(Embedded::PinRegister state);
 	bool isBreadboard();
 
 	void printConnections();
@@ -183,6 +158,7 @@ public:
 
 public slots:
 	void connectionUpdate(bool active);
+	void pinsChanged(Board::PinRegister state, Board::PinRegister changed);
 
 private slots:
 	void removePinTriggered();
@@ -1,13 +1,11 @@
 #pragma once
 
+#include <geometry.h>
+
 #include <QString>
-#include <QSize>
 
 const QString DEFAULT_PATH = ":/img/virtual_breadboard.png";
-const QSize DEFAULT_SIZE = QSize(486, 233);
 
-const unsigned BB_ROWS = 80;
-const unsigned BB_ONE_ROW = BB_ROWS/2;
 const unsigned BB_INDEXES = 5;
 
 const QString DRAG_TYPE_DEVICE = "device";
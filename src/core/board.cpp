@@ -0,0 +1,243 @@
+#include "board.h"
+
+#include <QJsonArray>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace gpio;
+using namespace std;
+
+Board::Board(const std::string& host, const std::string& port) : QObject(), m_gpio(host, port) {
+	connect(&m_gpio, &GpioThread::stateUpdated, this, &Board::stateUpdated);
+	connect(&m_gpio, &GpioThread::connectionChanged, this, &Board::connectionChanged);
+}
+
+Board::~Board() = default;
+
+void Board::start() {
+	m_gpio.start();
+}
+
+void Board::stop() {
+	m_gpio.stop();
+}
+
+PinNumber Board::translatePinToGpioOffs(PinNumber pin) {
+	auto pin_obj = m_pins.find(pin);
+	if(pin_obj == m_pins.end()) {
+		return invalidPin();
+	}
+	return pin_obj->second.gpio_offs;
+}
+
+Board::PinRegister Board::translateGpioToGlobal(State state) {
+	PinRegister ext = 0;
+	for(const auto& [global, pin_obj] : m_pins) {
+		ext |= static_cast<PinRegister>(state.pins[pin_obj.gpio_offs] == gpio::Pinstate::HIGH ? 1 : 0) << global;
+	}
+	return ext;
+}
+
+gpio::PinNumber Board::invalidPin() {
+	static_assert(gpio::max_num_pins < numeric_limits<gpio::PinNumber>::max(),
+				  "Invalid Pin hides a valid pin number");
+	return numeric_limits<gpio::PinNumber>::max();
+}
+
+const GPIOPinLayout& Board::getPins() const {
+	return m_pins;
+}
+
+bool Board::isPin(gpio::PinNumber pin) {
+	return m_pins.find(pin) != m_pins.end();
+}
+
+bool Board::isIOFActive(gpio::PinNumber pin, IOFType type) {
+	auto pin_obj = m_pins.find(pin);
+	if(pin_obj == m_pins.end()) return false;
+	return find_if(pin_obj->second.iofs.begin(), pin_obj->second.iofs.end(), [type](const IOF& iof){
+		return iof.type == type && iof.active;
+	}) != pin_obj->second.iofs.end();
+}
+
+void Board::setIOFs(const std::list<std::pair<gpio::PinNumber, IOF>>& iofs) {
+	for(const auto& [global, iof] : iofs) {
+		auto pin = m_pins.find(global);
+		if(pin == m_pins.end()) continue;
+		IOFType type = iof.type;
+		auto pin_iof = std::find_if(pin->second.iofs.begin(), pin->second.iofs.end(),[type](IOF i){
+			return type == i.type;
+		});
+		if(pin_iof == pin->second.iofs.end()) continue;
+		pin_iof->active = iof.active;
+	}
+}
+
+/* GPIO */
+
+void Board::connectionChanged(bool connected) {
+	if(connected == m_connected) return;
+	m_connected = connected;
+	if(m_connected) {
+		m_state_valid = false;
+		emit(connectionEstablished());
+	}
+	else {
+		emit(connectionLost());
+	}
+}
+
+void Board::stateUpdated() {
+	if(!m_connected || !m_gpio.getState(m_gpio_state)) return;
+	for (auto &[global, info]: m_pins) {
+		for (auto &iof: info.iofs) {
+			if (iof.type == IOFType::SPI) {
+				iof.active = m_gpio_state.pins[info.gpio_offs] == gpio::Pinstate::IOF_SPI;
+			}
+		}
+	}
+	const PinRegister state = getState();
+	const PinRegister changed = m_state_valid ? state ^ m_state : ~static_cast<PinRegister>(0);
+	m_state = state;
+	m_state_valid = true;
+	if(changed) {
+		emit(stateChanged(state, changed));
+	}
+}
+
+Board::PinRegister Board::getState() {
+	return translateGpioToGlobal(m_gpio_state);
+}
+
+bool Board::isConnected() const {
+	return m_connected;
+}
+
+void Board::registerIOF_PIN(PinNumber global, GpioClient::OnChange_PIN fun) {
+	m_gpio.request(GpioThread::Request{
+		.type = GpioThread::Request::Type::registerPIN,
+		.gpio_offs = translatePinToGpioOffs(global),
+		.pin_fun = fun
+	});
+}
+
+void Board::registerIOF_SPI(PinNumber global, GpioClient::OnChange_SPI fun, bool no_response) {
+	m_gpio.request(GpioThread::Request{
+		.type = GpioThread::Request::Type::registerSPI,
+		.gpio_offs = translatePinToGpioOffs(global),
+		.noresponse = no_response,
+		.spi_fun = fun
+	});
+}
+
+void Board::closeIOF(PinNumber global) {
+	m_gpio.closeIOF(translatePinToGpioOffs(global));
+}
+
+void Board::setBit(gpio::PinNumber global, gpio::Tristate state) {
+	PinWrite pins;
+	pins.set(global, state);
+	setBits(pins);
+}
+
+void Board::setBits(const PinWrite& pins) {
+	if(!m_connected || pins.empty()) return;
+	// All pins of one step are handed to the I/O thread as a single request
+	PinWrite gpio_pins;
+	pins.forEach([this, &gpio_pins](unsigned global, gpio::Tristate state) {
+		const gpio::PinNumber gpio_offs = translatePinToGpioOffs(global);
+		if(gpio_offs == invalidPin()) return;
+		gpio_pins.set(gpio_offs, state);
+	});
+	m_gpio.request(GpioThread::Request{
+		.type = GpioThread::Request::Type::setBits,
+		.pins = gpio_pins
+	});
+}
+
+/* JSON */
+
+bool Board::fromJSON(QJsonObject json) {
+	if(!json.contains("pins") || !json["pins"].isArray()) {
+		cerr << "[Board] JSON missing pins entry" << endl;
+		return false;
+	}
+
+	m_pins.clear();
+	QJsonArray pins = json["pins"].toArray();
+	for(const auto& pin_obj : pins) {
+		QJsonObject pin = pin_obj.toObject();
+		if(!pin.contains("global") || !pin["global"].isDouble()
+		|| !pin.contains("gpio_offs") || !pin["gpio_offs"].isDouble()
+		|| !pin.contains("pos_x") || !pin["pos_x"].isDouble()
+		|| !pin.contains("pos_y") || !pin["pos_y"].isDouble()) {
+			cerr << "[Board] JSON missing global/gpio offs/position entry for a pin" << endl;
+			continue;
+		}
+		gpio::PinNumber global = pin["global"].toInt();
+		gpio::PinNumber gpio_offs = pin["gpio_offs"].toInt();
+		list<IOF> iofs;
+		if(pin.contains("iofs") && pin["iofs"].isArray()) {
+			QJsonArray iofs_obj = pin["iofs"].toArray();
+			for (const auto &iof_obj: iofs_obj) {
+				QJsonObject iof = iof_obj.toObject();
+				if(!iof.contains("type") || !iof["type"].isString()) {
+					cerr << "[Board] JSON missing type for iof of pin " << (int) global << endl;
+					continue;
+				}
+				bool active = iof["active"].toBool(false);
+				IOFType type;
+				QString type_str = iof["type"].toString();
+				if (type_str == "UART") type = IOFType::UART;
+				else if (type_str == "SPI") type = IOFType::SPI;
+				else if (type_str == "PWM") type = IOFType::PWM;
+				else {
+					cerr << "[Board] JSON has invalid iof type " << type_str.toStdString() << " for pin " << (int) global << endl;
+					continue;
+				}
+				iofs.push_back(IOF{.type=type, .active=active});
+			}
+		}
+		QPoint pos = QPoint(pin["pos_x"].toInt(), pin["pos_y"].toInt());
+		m_pins.emplace(global, GPIOPin{.gpio_offs=gpio_offs,.iofs=iofs, .pos=pos});
+	}
+	return true;
+}
+
+QJsonObject Board::toJSON() {
+	QJsonObject json;
+	QJsonArray pins;
+	for(const auto& [global, pin] : m_pins) {
+		QJsonObject pin_obj;
+		pin_obj["global"] = global;
+		pin_obj["gpio_offs"] = pin.gpio_offs;
+		QJsonArray iofs;
+		for(const auto& iof : pin.iofs) {
+			QJsonObject iof_obj;
+			QString type;
+			switch(iof.type) {
+				case IOFType::PWM:
+					type = "PWM";
+					break;
+				case IOFType::SPI:
+					type = "SPI";
+					break;
+				case IOFType::UART:
+					type = "UART";
+					break;
+			}
+			iof_obj["type"] = type;
+			iof_obj["active"] = iof.active;
+			iofs.append(iof_obj);
+		}
+		if(!iofs.empty()) {
+			pin_obj["iofs"] = iofs;
+		}
+		pin_obj["pos_x"] = pin.pos.x();
+		pin_obj["pos_y"] = pin.pos.y();
+		pins.append(pin_obj);
+	}
+	json["pins"] = pins;
+	return json;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "types.h"
+#include "gpio-thread.h"
+
+#include <QObject>
+#include <QJsonObject>
+
+#include <list>
+
+/**
+ * The embedded board without any widget: its pin layout, the connection to
+ * the VP and the current pin register. Shared by the GUI and the headless mode.
+ */
+class Board : public QObject {
+	Q_OBJECT
+
+public:
+	typedef uint64_t PinRegister;
+
+private:
+	GPIOPinLayout m_pins;
+
+	GpioThread m_gpio;
+	gpio::State m_gpio_state = {};
+
+	bool m_connected = false;
+	PinRegister m_state = 0;
+	bool m_state_valid = false;	// forces a full update after (re)connecting
+
+	gpio::PinNumber translatePinToGpioOffs(gpio::PinNumber pin);
+	PinRegister translateGpioToGlobal(gpio::State state);
+
+private slots:
+	void stateUpdated();
+	void connectionChanged(bool connected);
+
+public:
+	Board(const std::string& host, const std::string& port);
+	~Board();
+
+	void start();
+	void stop();
+
+	PinRegister getState();
+	bool isConnected() const;
+	const GPIOPinLayout& getPins() const;
+	bool isPin(gpio::PinNumber pin);
+	bool isIOFActive(gpio::PinNumber pin, IOFType type);
+	gpio::PinNumber invalidPin();
+	void setIOFs(const std::list<std::pair<gpio::PinNumber, IOF>>& iofs);
+
+	bool fromJSON(QJsonObject json);
+	QJsonObject toJSON();
+
+	void registerIOF_PIN(gpio::PinNumber global, GpioClient::OnChange_PIN fun);
+	void registerIOF_SPI(gpio::PinNumber global, GpioClient::OnChange_SPI fun, bool noresponse);
+	/**
+	 * Returns once the VP will not call the IOF callback anymore
+	 */
+	void closeIOF(gpio::PinNumber global);
+	void setBit(gpio::PinNumber global, gpio::Tristate state);
+	void setBits(const PinWrite& pins);
+
+signals:
+	void connectionLost();
+	void connectionEstablished();
+	void stateChanged(Board::PinRegister state, Board::PinRegister changed);
+};
@@ -0,0 +1,514 @@
+#include "circuit.h"
+
+#include <QJsonArray>
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+using namespace std;
+
+Circuit::Circuit(Factory& factory, Board& board) : QObject(), m_factory(factory), m_board(board) {
+	// timed devices may have changed their outputs
+	connect(&m_scheduler, &Scheduler::woken, this, &Circuit::writeDevice);
+}
+
+Circuit::~Circuit() {
+	// IOF callbacks point to the devices, they have to be gone before the devices are
+	clear();
+}
+
+Board& Circuit::getBoard() {
+	return m_board;
+}
+
+/* JSON */
+
+bool Circuit::parseDevice(const QJsonObject& json, DeviceDescription& device) {
+	if(!json.contains("id") || !json["id"].isString() || !json.contains("graphics") || !json["graphics"].isObject()) {
+		cerr << "[Circuit] Config misses information/malformed for a device" << endl;
+		return false;
+	}
+	QJsonObject graphics = json["graphics"].toObject();
+	if(!graphics.contains("offs") || !graphics["offs"].isArray() || graphics["offs"].toArray().size() != 2) {
+		cerr << "[Circuit] Config misses position of a device" << endl;
+		return false;
+	}
+	const QJsonArray offs_desc = graphics["offs"].toArray();
+	device.id = json["id"].toString().toStdString();
+	device.classname = json["class"].toString("undefined").toStdString();
+	device.offs = QPoint(offs_desc[0].toInt(), offs_desc[1].toInt());
+	device.json = json;
+	device.connections.clear();
+	if(json.contains("pins") && json["pins"].isArray()) {
+		for(const auto& connection_obj : json["pins"].toArray()) {
+			ConnectionDescription connection;
+			if(parseConnection(connection_obj.toObject(), connection)) {
+				device.connections.push_back(connection);
+			}
+		}
+	}
+	return true;
+}
+
+bool Circuit::parseConnection(const QJsonObject& json, ConnectionDescription& connection) {
+	if(!json.contains("device_pin") || !json.contains("global_pin")) {
+		cerr << "[Circuit] JSON entry for a connection is missing device pin or global pin" << endl;
+		return false;
+	}
+	connection.global_pin = json["global_pin"].toInt();
+	connection.device_pin = json["device_pin"].toInt();
+	connection.name = json["name"].toString("undefined").toStdString();
+	connection.synchronous = json["synchronous"].toBool(false);
+	if(json.contains("spi_noresponse") && json["spi_noresponse"].isBool()) {
+		connection.spi_noresponse = json["spi_noresponse"].toBool();
+	}
+	else {
+		connection.spi_noresponse.reset();
+	}
+	return true;
+}
+
+QJsonObject Circuit::connectionToJSON(const ConnectionDescription& connection) {
+	QJsonObject json;
+	json["global_pin"] = connection.global_pin;
+	json["device_pin"] = (int) connection.device_pin;
+	json["name"] = QString::fromStdString(connection.name);
+	if(connection.synchronous) {
+		json["synchronous"] = true;
+	}
+	if(connection.spi_noresponse) {
+		json["spi_noresponse"] = *connection.spi_noresponse;
+	}
+	return json;
+}
+
+void Circuit::deviceFromJSON(const DeviceID& id, QJsonObject json) {
+	auto device = m_devices.find(id);
+	if(device == m_devices.end()) return;
+	device->second->m_access.lock();
+	device->second->fromJSON(json);
+	device->second->m_access.unlock();
+}
+
+/* Device */
+
+DeviceID Circuit::getNewDeviceID() {
+	std::set<unsigned> used_ids;
+	for(const auto& [id_it, device_it] : m_devices) {
+		if(find_if(id_it.begin(), id_it.end(), [](unsigned char c){return !isdigit(c);}) == id_it.end()) {
+			used_ids.insert(stoi(id_it));
+		}
+	}
+	unsigned id_int = 0;
+	for(unsigned used_id : used_ids) {
+		if(used_id > id_int)
+			break;
+		id_int++;
+	}
+	return std::to_string(id_int);
+}
+
+bool Circuit::addDevice(const DeviceID& id, const DeviceClass& classname, unsigned icon_size, QPoint offs) {
+	if(id.empty()) {
+		cerr << "[Circuit] Device ID cannot be empty string!" << endl;
+		return false;
+	}
+	if(!m_factory.deviceExists(classname)) {
+		cerr << "[Circuit] Class name '" << classname << "' invalid." << endl;
+		return false;
+	}
+	if(m_devices.find(id) != m_devices.end()) {
+		cerr << "[Circuit] Another device with the ID '" << id << "' already exists!" << endl;
+		return false;
+	}
+
+	unique_ptr<Device> device = m_factory.instantiateDevice(id, classname);
+	if(!device) {
+		cerr << "[Circuit] Could not instantiate " << classname << " device" << endl;
+		return false;
+	}
+	device->m_access.lock();
+	device->createBuffer(icon_size, offs);
+	device->m_access.unlock();
+
+	m_scheduler.attach(device.get());
+	m_devices.insert(make_pair(id, std::move(device)));
+	return true;
+}
+
+void Circuit::removeDevice(const DeviceID& id) {
+	if(m_pin_channels.contains(id)) removePinForDevice(m_pin_channels.find(id)->second.global_pin, id);
+	if(m_spi_channels.contains(id)) removeSPIForDevice(m_spi_channels.find(id)->second.global_pin, id);
+	m_writing_connections.remove_if([id](const PinMapping& mapping){return mapping.device == id;});
+	m_reading_connections.remove_if([id](const PinMapping& mapping){return mapping.device == id;});
+	m_netlist.invalidate();
+	auto device = m_devices.find(id);
+	if(device != m_devices.end()) {
+		m_scheduler.detach(device->second.get());
+	}
+	m_devices.erase(id);
+}
+
+Device* Circuit::getDevice(const DeviceID& id) {
+	auto device = m_devices.find(id);
+	if(device == m_devices.end()) return nullptr;
+	return device->second.get();
+}
+
+const Circuit::Devices& Circuit::getDevices() const {
+	return m_devices;
+}
+
+void Circuit::clear() {
+	for(const auto& [id,spi] : m_spi_channels) {
+		m_board.closeIOF(spi.global_pin);
+	}
+	for(const auto& [id,pin] : m_pin_channels) {
+		m_board.closeIOF(pin.global_pin);
+	}
+	m_spi_channels.clear();
+	m_pin_channels.clear();
+	m_writing_connections.clear();
+	m_reading_connections.clear();
+	m_netlist.invalidate();
+	for(const auto& [id, device] : m_devices) {
+		m_scheduler.detach(device.get());
+	}
+	m_devices.clear();
+}
+
+/* Connections */
+
+void Circuit::addConnection(gpio::PinNumber global, Device::PIN_Interface::DevicePin device_pin, const DeviceID& device_id) {
+	if(m_board.isIOFActive(global, IOFType::SPI)) {
+		registerSPI(global, device_pin, device_id, true);
+	}
+	else {
+		registerPin(global, device_pin, device_id);
+	}
+}
+
+void Circuit::setConnectionOptions(const DeviceID& device_id, const ConnectionDescription& connection) {
+	if(connection.synchronous) {
+		setPinSync(connection.global_pin, connection.device_pin, device_id, true);
+	}
+	if(connection.spi_noresponse) {
+		setSPInoresponse(connection.global_pin, *connection.spi_noresponse);
+	}
+}
+
+unordered_set<gpio::PinNumber> Circuit::getPinsToDevice(const DeviceID& device_id) {
+	unordered_set<gpio::PinNumber> connected_global;
+	auto sync_pin = m_pin_channels.find(device_id);
+	if(sync_pin != m_pin_channels.end()) {
+		connected_global.insert(sync_pin->second.global_pin);
+	}
+	auto spi = m_spi_channels.find(device_id);
+	if(spi != m_spi_channels.end()) {
+		connected_global.insert(spi->second.global_pin);
+	}
+	for(const auto& mapping : m_reading_connections) {
+		if(mapping.device == device_id) {
+			connected_global.insert(mapping.global_pin);
+		}
+	}
+	for(const auto& mapping : m_writing_connections) {
+		if(mapping.device == device_id) {
+			connected_global.insert(mapping.global_pin);
+		}
+	}
+	return connected_global;
+}
+
+unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber> Circuit::getPinsToDevicePins(const DeviceID& device_id) {
+	unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber> connected_global;
+	auto device = m_devices.find(device_id);
+	if(device == m_devices.end() || !device->second->m_pin) return connected_global;
+	auto sync = m_pin_channels.find(device_id);
+	if(sync!=m_pin_channels.end()) {
+		connected_global.emplace(sync->second.device_pin, sync->second.global_pin);
+	}
+	auto spi = m_spi_channels.find(device_id);
+	if(spi!=m_spi_channels.end()) {
+		connected_global.emplace(spi->second.cs_pin, spi->second.global_pin);
+	}
+	for(const auto& mapping : m_reading_connections) {
+		if(mapping.device == device_id) {
+			connected_global.emplace(mapping.device_pin, mapping.global_pin);
+		}
+	}
+	for(const auto& mapping : m_writing_connections) {
+		if(mapping.device == device_id) {
+			connected_global.emplace(mapping.device_pin, mapping.global_pin);
+		}
+	}
+	// invalid for all other device pins
+	device->second->m_access.lock();
+	for(const auto& [device_pin, desc] : device->second->m_pin->getPinLayout()) {
+		if(!connected_global.contains(device_pin)) {
+			connected_global.emplace(device_pin, numeric_limits<gpio::PinNumber>::max());
+		}
+	}
+	device->second->m_access.unlock();
+	return connected_global;
+}
+
+optional<pair<Device::PIN_Interface::DevicePin, gpio::PinNumber>> Circuit::getSyncPin(const DeviceID& device_id) {
+	auto sync = m_pin_channels.find(device_id);
+	if(sync == m_pin_channels.end()) return nullopt;
+	return make_pair(sync->second.device_pin, sync->second.global_pin);
+}
+
+void Circuit::registerPin(gpio::PinNumber global, Device::PIN_Interface::DevicePin device_pin, const DeviceID& device_id, bool synchronous) {
+	auto device = m_devices.find(device_id);
+	if(device == m_devices.end()) {
+		cerr << "[Circuit] Could not find device '" << device_id << "' when attempting to register pin " << (int) global << endl;
+		removeDevice(device_id);
+		return;
+	}
+	if(!device->second->m_pin) {
+		cerr << "[Circuit] Attempting to add pin connection for device '" << device_id <<
+			 "', but device does not implement PIN interface." << endl;
+		return;
+	}
+	device->second->m_access.lock();
+	const Device::PIN_Interface::PinDesc* offered_desc = device->second->m_pin->getPinDesc(device_pin);
+	const bool offered = offered_desc != nullptr;
+	const Device::PIN_Interface::Dir dir = offered ? offered_desc->dir : Device::PIN_Interface::Dir::input;
+	device->second->m_access.unlock();
+	if(!offered) {
+		cerr << "[Circuit] Attempting to add pin '" << (int)device_pin << "' for device " <<
+			 device_id << " that is not offered by device" << endl;
+		return;
+	}
+	if(synchronous) {
+		if(dir != Device::PIN_Interface::Dir::input) {
+			cerr << "[Circuit] Attempting to add pin '" << (int)device_pin << "' as synchronous for device " <<
+				 device_id << ", but device labels pin not as input."
+									   " This is not supported for inout-pins and unnecessary for output pins." << endl;
+			return;
+		}
+		auto device_ptr = device->second.get();
+		device_ptr->m_access.lock();
+		device_ptr->initializeBuffer();
+		device_ptr->m_access.unlock();
+		auto req = PIN_IOF_Request{
+				.global_pin = global,
+				.device_pin = device_pin,
+				.fun = [device_ptr, device_pin](gpio::Tristate pin) {
+					device_ptr->m_access.lock();
+					device_ptr->m_pin->setPin(device_pin, pin);
+					device_ptr->m_access.unlock();
+				}};
+		m_pin_channels.emplace(device_id, req);
+		if(m_board.isConnected()) {
+			m_board.registerIOF_PIN(req.global_pin, req.fun);
+		}
+	}
+	else {
+		PinMapping mapping = PinMapping{
+				.global_pin = global,
+				.device_pin = device_pin,
+				.device = device_id
+		};
+		if(dir == Device::PIN_Interface::Dir::input || dir == Device::PIN_Interface::Dir::inout) {
+			m_reading_connections.push_back(mapping);
+			m_netlist.invalidate();
+			if(m_board.isConnected()) {
+				// changes are only propagated on events, so the new connection needs the current value
+				device->second->m_access.lock();
+				device->second->m_pin->setPin(device_pin, ((m_board.getState() >> global)&1 ? gpio::Tristate::HIGH : gpio::Tristate::LOW));
+				device->second->m_access.unlock();
+			}
+		}
+		else if(dir == Device::PIN_Interface::Dir::output) {
+			m_writing_connections.push_back(mapping);
+			m_netlist.invalidate();
+			if(m_board.isConnected()) {
+				device->second->m_access.lock();
+				m_board.setBit(global, device->second->m_pin->getPin(device_pin));
+				device->second->m_access.unlock();
+			}
+		}
+	}
+}
+
+void Circuit::setPinSync(gpio::PinNumber global, Device::PIN_Interface::DevicePin device_pin, const DeviceID& device_id, bool synchronous) {
+	removeSPI(global);
+	removePinForDevice(global, device_id);
+	registerPin(global, device_pin, device_id, synchronous);
+}
+
+void Circuit::registerSPI(gpio::PinNumber global, Device::PIN_Interface::DevicePin cs_pin, const DeviceID& device_id, bool noresponse) {
+	auto device = m_devices.find(device_id);
+	if(device == m_devices.end()) {
+		cerr << "[Circuit] Could not find device '" << device_id << "' when attempting to register SPI" << endl;
+		removeDevice(device_id);
+		return;
+	}
+	if(!device->second->m_spi) {
+		cerr << "[Circuit] Attempting to add SPI connection for device '" << device_id <<
+			 "', but device does not implement SPI interface." << endl;
+		return;
+	}
+	auto device_ptr = device->second.get();
+	device_ptr->m_access.lock();
+	device_ptr->initializeBuffer();
+	device_ptr->m_access.unlock();
+	auto req = SPI_IOF_Request{
+			.global_pin = global,
+			.cs_pin = cs_pin,
+			.noresponse = noresponse,
+			.fun = [device_ptr, noresponse](gpio::SPI_Command cmd){
+				if(noresponse) {
+					// delivered as burst, latest on the next access or flush
+					device_ptr->queueSPI(cmd);
+					return gpio::SPI_Response(0);
+				}
+				device_ptr->m_access.lock();
+				const gpio::SPI_Response ret = device_ptr->m_spi->send(cmd);
+				device_ptr->m_access.unlock();
+				return ret;
+			}};
+	m_spi_channels.emplace(device_id, req);
+	if(m_board.isConnected()) {
+		m_board.registerIOF_SPI(req.global_pin, req.fun, req.noresponse);
+	}
+}
+
+void Circuit::setSPInoresponse(gpio::PinNumber global, bool noresponse) {
+	for(auto& [device, spi] : m_spi_channels) {
+		if(spi.global_pin == global) {
+			Device::PIN_Interface::DevicePin cs_pin = spi.cs_pin;
+			DeviceID device_id = device;
+			removeSPI(global);
+			registerSPI(global, cs_pin, device_id, noresponse);
+			break;
+		}
+	}
+}
+
+/* Remove */
+
+void Circuit::removeSPI(gpio::PinNumber global) {
+	bool exists = find_if(m_spi_channels.begin(), m_spi_channels.end(),
+						  [global](const auto& spi_pair){
+							  return spi_pair.second.global_pin == global;
+						  }) != m_spi_channels.end();
+	if(exists) {
+		m_board.closeIOF(global);
+		erase_if(m_spi_channels, [global](const auto& spi_pair){
+			return spi_pair.second.global_pin == global;
+		});
+	}
+}
+
+void Circuit::removeSPIForDevice(gpio::PinNumber global, const DeviceID& device_id) {
+	auto req = m_spi_channels.find(device_id);
+	if(req == m_spi_channels.end() || req->second.global_pin != global) return;
+	m_board.closeIOF(global);
+	m_spi_channels.erase(device_id);
+}
+
+void Circuit::removePin(gpio::PinNumber global) {
+	bool exists = find_if(m_pin_channels.begin(), m_pin_channels.end(),
+						  [global](const auto& pin_pair){
+							  return pin_pair.second.global_pin == global;
+						  }) != m_pin_channels.end();
+	if(exists) {
+		m_board.closeIOF(global);
+		erase_if(m_pin_channels, [global](const auto& pin_pair){
+			return pin_pair.second.global_pin == global;
+		});
+	}
+	m_writing_connections.remove_if([global](const PinMapping& mapping){return mapping.global_pin == global;});
+	m_reading_connections.remove_if([global](const PinMapping& mapping){return mapping.global_pin == global;});
+	m_netlist.invalidate();
+}
+
+void Circuit::removePinForDevice(gpio::PinNumber global, const DeviceID& device_id) {
+	auto req = m_pin_channels.find(device_id);
+	if(req != m_pin_channels.end() && req->second.global_pin == global) {
+		m_board.closeIOF(global);
+		m_pin_channels.erase(device_id);
+	}
+	m_writing_connections.remove_if([global,device_id](const PinMapping& mapping){
+		return mapping.device == device_id && mapping.global_pin == global;
+	});
+	m_reading_connections.remove_if([global, device_id](const PinMapping& mapping){
+		return mapping.device == device_id && mapping.global_pin == global;
+	});
+	m_netlist.invalidate();
+}
+
+void Circuit::printConnections() {
+	cout << "Connections:" << endl;
+	cout << "\tAsync writing:" << endl;
+	for(const PinMapping& mapping : m_writing_connections) {
+		cout << "\t\tGlobal pin " << (int) mapping.global_pin << " connected with device " << mapping.device << endl;
+	}
+	cout << "\tAsync reading:" << endl;
+	for(const PinMapping& mapping : m_reading_connections) {
+		cout << "\t\tGlobal pin " << (int) mapping.global_pin << " connected with device " << mapping.device << endl;
+	}
+	cout << "\tSync pins:" << endl;
+	for(const auto& [device_id, req] : m_pin_channels) {
+		cout << "\t\tGlobal pin " << (int) req.global_pin << " connected with device " << device_id << endl;
+	}
+	cout << "\tSync SPI:" << endl;
+	for(const auto& [device_id, req] : m_spi_channels) {
+		cout << "\t\tGlobal pin " << (int) req.global_pin << " connected with device " << device_id << endl;
+	}
+}
+
+/* Update */
+
+void Circuit::updateNetlist() {
+	if(!m_netlist.isValid()) {
+		m_netlist.compile(m_reading_connections, m_writing_connections, m_devices);
+	}
+}
+
+void Circuit::flushSPI() {
+	for(const auto& [id, device] : m_devices) {
+		device->flushSPI();
+	}
+}
+
+void Circuit::pinsChanged(Board::PinRegister state, Board::PinRegister changed) {
+	updateNetlist();
+	PinWrite pins;
+	m_netlist.propagate(state, changed, [&pins](gpio::PinNumber global, gpio::Tristate val) {
+		pins.set(global, val);
+	});
+	m_board.setBits(pins);
+}
+
+void Circuit::connectionUpdate(bool active) {
+	if(active) {
+		for(const auto& [id, req] : m_spi_channels) {
+			m_board.registerIOF_SPI(req.global_pin, req.fun, req.noresponse);
+		}
+		for(const auto& [id, req] : m_pin_channels) {
+			m_board.registerIOF_PIN(req.global_pin, req.fun);
+		}
+		updateNetlist();
+		PinWrite pins;
+		m_netlist.writeAll([&pins](gpio::PinNumber global, gpio::Tristate val) {
+			pins.set(global, val);
+		});
+		m_board.setBits(pins);
+	}
+	// else connection lost
+}
+
+void Circuit::writeDevice(const DeviceID& id) {
+	if(!m_devices.contains(id)) return;
+	updateNetlist();
+	PinWrite pins;
+	m_netlist.writeDevice(id, [&pins](gpio::PinNumber global, gpio::Tristate val) {
+		pins.set(global, val);
+	});
+	m_board.setBits(pins);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "board.h"
+#include "netlist.h"
+#include "scheduler.h"
+
+#include <factory/factory.h>
+
+#include <QObject>
+#include <QJsonObject>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <list>
+#include <optional>
+
+/**
+ * Devices and their connections to a board, without any widget: loads devices
+ * from JSON, registers the IOFs and compiles the netlist that propagates pin
+ * changes. The breadboard widget and the headless mode are built on top of it.
+ */
+class Circuit : public QObject {
+	Q_OBJECT
+
+public:
+	typedef Board::PinRegister PinRegister;
+	typedef Netlist::Devices Devices;
+
+	struct ConnectionDescription {
+		gpio::PinNumber global_pin;
+		Device::PIN_Interface::DevicePin device_pin;
+		std::string name;
+		bool synchronous = false;
+		std::optional<bool> spi_noresponse;
+	};
+
+	struct DeviceDescription {
+		DeviceID id;
+		DeviceClass classname;
+		QPoint offs;
+		QJsonObject json;
+		std::list<ConnectionDescription> connections;
+	};
+
+private:
+	struct SPI_IOF_Request {
+		gpio::PinNumber global_pin;
+		Device::PIN_Interface::DevicePin cs_pin;
+		bool noresponse;
+		GpioClient::OnChange_SPI fun;
+	};
+
+	struct PIN_IOF_Request {
+		gpio::PinNumber global_pin;
+		Device::PIN_Interface::DevicePin device_pin;
+		GpioClient::OnChange_PIN fun;
+	};
+
+	typedef Netlist::PinMapping PinMapping;
+
+	Factory& m_factory;
+	Board& m_board;		// has to outlive the circuit, IOFs are closed on destruction
+	Scheduler m_scheduler;		// declared first to outlive the devices
+	Devices m_devices;
+
+	std::unordered_map<DeviceID,SPI_IOF_Request> m_spi_channels;
+	std::unordered_map<DeviceID,PIN_IOF_Request> m_pin_channels;
+	std::list<PinMapping> m_reading_connections;
+	std::list<PinMapping> m_writing_connections;
+	Netlist m_netlist;	// compiled from reading and writing connections
+
+	void updateNetlist();
+
+public:
+	Circuit(Factory& factory, Board& board);
+	~Circuit();
+
+	Board& getBoard();
+
+	// JSON
+	static bool parseDevice(const QJsonObject& json, DeviceDescription& device);
+	static bool parseConnection(const QJsonObject& json, ConnectionDescription& connection);
+	static QJsonObject connectionToJSON(const ConnectionDescription& connection);
+	void deviceFromJSON(const DeviceID& id, QJsonObject json);
+
+	// Device
+	DeviceID getNewDeviceID();
+	bool addDevice(const DeviceID& id, const DeviceClass& classname, unsigned icon_size, QPoint offs);
+	void removeDevice(const DeviceID& id);
+	Device* getDevice(const DeviceID& id);
+	const Devices& getDevices() const;
+	void clear();
+
+	// Connections
+	/**
+	 * Connects the device pin to the global pin, as SPI if the board has the SPI IOF of the pin active
+	 */
+	void addConnection(gpio::PinNumber global, Device::PIN_Interface::DevicePin device_pin, const DeviceID& device_id);
+	/**
+	 * Applies the synchronous and SPI options of a connection that was already added
+	 */
+	void setConnectionOptions(const DeviceID& device_id, const ConnectionDescription& connection);
+	std::unordered_set<gpio::PinNumber> getPinsToDevice(const DeviceID& device_id);
+	std::unordered_map<Device::PIN_Interface::DevicePin, gpio::PinNumber> getPinsToDevicePins(const DeviceID& device_id);
+	std::optional<std::pair<Device::PIN_Interface::DevicePin, gpio::PinNumber>> getSyncPin(const DeviceID& device_id);
+	void registerPin(gpio::PinNumber global, Device::PIN_Interface::DevicePin device_pin, const DeviceID& device_id, bool synchronous=false);
+	void setPinSync(gpio::PinNumber global, Device::PIN_Interface::DevicePin device_pin, const DeviceID& device_id, bool synchronous);
+	void registerSPI(gpio::PinNumber global, Device::PIN_Interface::DevicePin cs_pin, const DeviceID& device_id, bool noresponse);
+	void setSPInoresponse(gpio::PinNumber global, bool noresponse);
+	void removeSPI(gpio::PinNumber global);
+	void removeSPIForDevice(gpio::PinNumber global, const DeviceID& device_id);
+	void removePin(gpio::PinNumber global);
+	void removePinForDevice(gpio::PinNumber global, const DeviceID& device_id);
+	void printConnections();
+
+	void flushSPI();
+
+public slots:
+	void writeDevice(const DeviceID& id);
+	void connectionUpdate(bool active);
+	void pinsChanged(Board::PinRegister state, Board::PinRegister changed);
+};
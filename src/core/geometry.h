@@ -0,0 +1,9 @@
+#pragma once
+
+#include <QSize>
+
+/* Breadboard dimensions, device sizes of the GUI and the headless mode are derived from them */
+const QSize DEFAULT_SIZE = QSize(486, 233);
+
+const unsigned BB_ROWS = 80;
+const unsigned BB_ONE_ROW = BB_ROWS/2;
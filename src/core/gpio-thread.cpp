@@ -0,0 +1,232 @@
+#include "gpio-thread.h"
+
+#include <QTimer>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+constexpr auto min_poll_interval = chrono::milliseconds(1);
+constexpr auto max_poll_interval = chrono::milliseconds(4);	// idle, also the latency of the first edge after idling
+constexpr auto reconnect_interval = chrono::milliseconds(250);
+constexpr auto overflow_retry_interval = chrono::milliseconds(1);
+
+static_assert(gpio::max_num_pins <= PinWrite::max_pins, "Pin writes cannot hold all gpio offsets");
+
+GpioThread::GpioThread(const std::string& host, const std::string& port) : QObject(), m_host(host), m_port(port) {}
+
+GpioThread::~GpioThread() {
+	stop();
+}
+
+void GpioThread::start() {
+	if(m_running.exchange(true)) return;
+	m_thread = thread(&GpioThread::run, this);
+}
+
+void GpioThread::stop() {
+	m_running = false;
+	wake();
+	if(m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+bool GpioThread::isConnected() const {
+	return m_connected;
+}
+
+bool GpioThread::getState(gpio::State& state) {
+	m_notified = false;
+	if(!m_state.update()) return false;
+	state = m_state.front();
+	return true;
+}
+
+bool GpioThread::queueOverflow() {
+	if(m_overflow.empty()) return true;
+	if(!m_requests.push(Request{.type = Request::Type::setBits, .pins = m_overflow})) return false;
+	m_overflow = PinWrite();
+	return true;
+}
+
+void GpioThread::retryOverflow() {
+	m_overflow_retry = false;
+	if(!m_connected) {
+		m_overflow = PinWrite();	// stale, all outputs are written again after reconnecting
+		return;
+	}
+	if(!queueOverflow()) {
+		m_overflow_retry = true;
+		QTimer::singleShot(overflow_retry_interval, this, &GpioThread::retryOverflow);
+		return;
+	}
+	wake();
+}
+
+bool GpioThread::request(Request&& req) {
+	if(!m_connected) {
+		m_overflow = PinWrite();
+		return false;
+	}
+	// newer requests must not overtake the pin writes waiting in the overflow
+	if(queueOverflow() && m_requests.push(std::move(req))) {
+		wake();
+		return true;
+	}
+	if(req.type != Request::Type::setBits) {
+		cerr << "[GpioThread] Request queue is full, dropping request" << endl;
+		return false;
+	}
+	req.pins.forEach([this](unsigned gpio_offs, gpio::Tristate state) {
+		m_overflow.set(gpio_offs, state);
+	});
+	if(!m_overflow_retry) {
+		m_overflow_retry = true;
+		QTimer::singleShot(overflow_retry_interval, this, &GpioThread::retryOverflow);
+	}
+	wake();
+	return true;
+}
+
+void GpioThread::closeIOF(gpio::PinNumber gpio_offs) {
+	if(!m_running) {
+		// no I/O thread that could race with us
+		m_gpio.closeIOFunction(gpio_offs);
+		return;
+	}
+	promise<void> closed;
+	future<void> done = closed.get_future();
+	// also while disconnected, the client may still hold the callback
+	while(!queueOverflow() || !m_requests.push(Request{
+		.type = Request::Type::closeIOF,
+		.gpio_offs = gpio_offs,
+		.handled = &closed
+	})) {
+		this_thread::yield();
+	}
+	wake();
+	done.wait();
+}
+
+void GpioThread::wake() {
+	{
+		lock_guard<mutex> lock(m_wakeup_mutex);
+		m_woken = true;
+	}
+	m_wakeup.notify_one();
+}
+
+void GpioThread::sleep(chrono::milliseconds timeout) {
+	unique_lock<mutex> lock(m_wakeup_mutex);
+	m_wakeup.wait_for(lock, timeout, [this]{ return m_woken; });
+	m_woken = false;
+}
+
+/* I/O thread */
+
+void GpioThread::flushPins(PinWrite& pins) {
+	// The protocol has no multi-pin request and the client does not share its socket,
+	// so this stays one SET_BIT per pin until the protocol offers a mask/value message.
+	pins.forEach([this](unsigned gpio_offs, gpio::Tristate state) {
+		m_gpio.setBit(gpio_offs, state);
+	});
+	pins = PinWrite();
+}
+
+bool GpioThread::handleRequests() {
+	// Pin writes of all pending requests are merged, so every pin is sent once with
+	// its latest level. Only a request for a pin with a pending write has to wait for it.
+	PinWrite pins;
+	auto flushFor = [this, &pins](gpio::PinNumber gpio_offs) {
+		if(m_connected && gpio_offs < PinWrite::max_pins && ((pins.mask >> gpio_offs) & 1)) {
+			flushPins(pins);
+		}
+	};
+	Request req;
+	bool handled = false;
+	while(m_requests.pop(req)) {
+		handled = true;
+		if(req.type == Request::Type::closeIOF) {
+			flushFor(req.gpio_offs);
+			m_gpio.closeIOFunction(req.gpio_offs);
+			if(req.handled) req.handled->set_value();
+			continue;
+		}
+		if(!m_connected) continue;	// stale, everything is registered again after reconnecting
+		if(req.type == Request::Type::setBits) {
+			req.pins.forEach([&pins](unsigned gpio_offs, gpio::Tristate state) {
+				pins.set(gpio_offs, state);
+			});
+			continue;
+		}
+		flushFor(req.gpio_offs);
+		switch(req.type) {
+		case Request::Type::setBits:
+			break;
+		case Request::Type::registerPIN:
+			if(!m_gpio.isIOFactive(req.gpio_offs)) {
+				m_gpio.registerPINOnChange(req.gpio_offs, req.pin_fun);
+			}
+			break;
+		case Request::Type::registerSPI:
+			if(!m_gpio.isIOFactive(req.gpio_offs)) {
+				m_gpio.registerSPIOnChange(req.gpio_offs, req.spi_fun, req.noresponse);
+			}
+			break;
+		case Request::Type::closeIOF:
+			break;
+		}
+	}
+	if(m_connected) {
+		flushPins(pins);
+	}
+	return handled;
+}
+
+bool GpioThread::publishState(bool force) {
+	if(!force && memcmp(&m_published, &m_gpio.state, sizeof(gpio::State)) == 0) return false;
+	m_published = m_gpio.state;
+	m_state.back() = m_published;
+	m_state.publish();
+	if(!m_notified.exchange(true)) {
+		emit(stateUpdated());
+	}
+	return true;
+}
+
+void GpioThread::run() {
+	bool force_publish = false;
+	auto poll_interval = min_poll_interval;
+	while(m_running) {
+		if(!m_connected) {
+			handleRequests();
+			if(!m_gpio.setupConnection(m_host.c_str(), m_port.c_str())) {
+				sleep(reconnect_interval);
+				continue;
+			}
+			m_connected = true;
+			force_publish = true;
+			emit(connectionChanged(true));
+		}
+		const bool requested = handleRequests();
+		if(!m_gpio.update()) {
+			m_connected = false;
+			emit(connectionChanged(false));
+			continue;
+		}
+		const bool changed = publishState(force_publish);
+		force_publish = false;
+		// the VP reacts on our writes, so those count as activity as well
+		poll_interval = changed || requested ? min_poll_interval : min(2 * poll_interval, max_poll_interval);
+		sleep(poll_interval);
+	}
+	// nobody waits for requests after stop(), but blocking ones must not be lost
+	handleRequests();
+	if(m_connected) {
+		m_gpio.destroyConnection();
+		m_connected = false;
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "lockfree.h"
+#include "pinwrite.h"
+
+#include <gpio-client.hpp>
+
+#include <QObject>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * Owns the GpioClient and does all (blocking) network I/O on its own thread.
+ * New states are published through a triple buffer, requests from the
+ * owning thread are passed in through a wait-free queue and wake the thread.
+ * Pin writes that do not fit into the queue are merged and queued again later.
+ * While the VP state does not change, polling backs off exponentially.
+ */
+class GpioThread : public QObject {
+	Q_OBJECT
+
+public:
+	struct Request {
+		enum class Type {
+			setBits,
+			registerPIN,
+			registerSPI,
+			closeIOF
+		} type = Type::setBits;
+		gpio::PinNumber gpio_offs = 0;
+		bool noresponse = false;
+		GpioClient::OnChange_PIN pin_fun;
+		GpioClient::OnChange_SPI spi_fun;
+		PinWrite pins;		// by gpio offset
+		std::promise<void>* handled = nullptr;	// fulfilled by the I/O thread, for blocking requests
+	};
+
+private:
+	const std::string m_host;
+	const std::string m_port;
+
+	std::thread m_thread;
+	std::atomic<bool> m_running = false;
+	std::atomic<bool> m_connected = false;
+	std::atomic<bool> m_notified = false;
+
+	std::mutex m_wakeup_mutex;
+	std::condition_variable m_wakeup;
+	bool m_woken = false;
+
+	TripleBuffer<gpio::State> m_state;
+	SPSCQueue<Request, 1024> m_requests;
+
+	// only accessed by the owning thread
+	PinWrite m_overflow;	// pin writes waiting for space in the queue
+	bool m_overflow_retry = false;
+
+	// only accessed by the I/O thread
+	GpioClient m_gpio;
+	gpio::State m_published;
+
+	void run();
+	bool handleRequests();
+	void flushPins(PinWrite& pins);
+	bool publishState(bool force);
+	void wake();
+	void sleep(std::chrono::milliseconds timeout);
+	bool queueOverflow();
+	void retryOverflow();
+
+public:
+	GpioThread(const std::string& host, const std::string& port);
+	~GpioThread();
+
+	void start();
+	void stop();
+	bool isConnected() const;
+
+	/**
+	 * @return false if there is no new state since the last call
+	 */
+	bool getState(gpio::State& state);
+	/**
+	 * Pin writes are never dropped while connected, other requests are if the queue is full
+	 * @return false if the request was dropped
+	 */
+	bool request(Request&& req);
+	/**
+	 * Returns once the client does not call the IOF's callback anymore,
+	 * so the callee may be destroyed afterwards
+	 */
+	void closeIOF(gpio::PinNumber gpio_offs);
+
+signals:
+	void stateUpdated();
+	void connectionChanged(bool connected);
+};
@@ -0,0 +1,130 @@
+#include "headless.h"
+#include "geometry.h"
+
+#include <QFile>
+#include <QTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonParseError>
+
+#include <iostream>
+
+using namespace std;
+
+/* Device buffers are sized as on a breadboard window of default size */
+const unsigned icon_size_minimum = DEFAULT_SIZE.width()/BB_ONE_ROW;
+/* Queued SPI bytes are delivered at least this often, as on the GUI's repaint timer */
+const int spi_flush_interval_ms = 1000/30;
+
+Headless::Headless(Factory& factory, const std::string& host, const std::string& port) : QObject(),
+		m_factory(factory), m_board(host, port), m_circuit(factory, m_board) {
+	connect(&m_board, &Board::connectionEstablished, this, &Headless::connectionEstablished);
+	connect(&m_board, &Board::connectionLost, this, &Headless::connectionLost);
+	connect(&m_board, &Board::stateChanged, &m_circuit, &Circuit::pinsChanged);
+	auto *timer = new QTimer(this);
+	connect(timer, &QTimer::timeout, &m_circuit, &Circuit::flushSPI);
+	timer->start(spi_flush_interval_ms);
+}
+
+Headless::~Headless() = default;
+
+void Headless::additionalLuaDir(const string& additional_device_dir, bool overwrite_integrated_devices) {
+	if(!additional_device_dir.empty()) {
+		m_factory.scanAdditionalDir(additional_device_dir, overwrite_integrated_devices);
+	}
+}
+
+void Headless::exportSharedMemory(const string& prefix) {
+	m_shm = make_unique<ShmExport>(prefix);
+	auto *timer = new QTimer(this);
+	connect(timer, &QTimer::timeout, this, &Headless::exportState);
+	timer->start(spi_flush_interval_ms);
+}
+
+void Headless::start() {
+	m_board.start();
+}
+
+/* JSON */
+
+bool Headless::loadJSON(const QString& file) {
+	QFile confFile(file);
+	if (!confFile.open(QIODevice::ReadOnly)) {
+		cerr << "[Headless] Could not open config file " << file.toStdString() << endl;
+		return false;
+	}
+
+	QJsonParseError error;
+	QJsonDocument json_doc = QJsonDocument::fromJson(confFile.readAll(), &error);
+	if(json_doc.isNull()) {
+		cerr << "[Headless] Config seems to be invalid: ";
+		cerr << error.errorString().toStdString() << endl;
+		return false;
+	}
+
+	QJsonObject json = json_doc.object();
+	if(!json.contains("embedded") || !json["embedded"].isObject()) {
+		cerr << "[Headless] Config file missing/malformed entry for embedded" << endl;
+		return false;
+	}
+	if(!json.contains("breadboard") || !json["breadboard"].isObject()) {
+		cerr << "[Headless] Config file missing/malformed entry for breadboard" << endl;
+		return false;
+	}
+	return m_board.fromJSON(json["embedded"].toObject()) && breadboardFromJSON(json["breadboard"].toObject());
+}
+
+bool Headless::breadboardFromJSON(QJsonObject json) {
+	if(!json.contains("devices") || !json["devices"].isArray()) {
+		cerr << "[Headless] JSON missing devices entry" << endl;
+		return false;
+	}
+	for(const auto& device_description : json["devices"].toArray()) {
+		Circuit::DeviceDescription device_desc;
+		if(!Circuit::parseDevice(device_description.toObject(), device_desc)) {
+			continue;
+		}
+		if(!m_circuit.addDevice(device_desc.id, device_desc.classname, icon_size_minimum, device_desc.offs)) {
+			continue;
+		}
+		m_circuit.deviceFromJSON(device_desc.id, device_desc.json);
+
+		for(const auto& connection : device_desc.connections) {
+			if(!m_board.isPin(connection.global_pin)) {
+				cerr << "[Headless] Global pin " << (int) connection.global_pin << " does not exist on embedded device" << endl;
+				continue;
+			}
+			m_circuit.addConnection(connection.global_pin, connection.device_pin, device_desc.id);
+			m_circuit.setConnectionOptions(device_desc.id, connection);
+		}
+	}
+	return true;
+}
+
+/* GPIO */
+
+void Headless::connectionEstablished() {
+	cout << "[Headless] Connected" << endl;
+	m_circuit.connectionUpdate(true);
+}
+
+void Headless::connectionLost() {
+	cout << "[Headless] Connection closed" << endl;
+	for(const auto& [id, device] : m_circuit.getDevices()) {
+		device->m_access.lock();
+		const string statistics = device->getStatistics();
+		device->m_access.unlock();
+		if(!statistics.empty()) {
+			cout << "[Headless] " << id << ": " << statistics << endl;
+		}
+	}
+	m_board.stop();
+	emit(finished());
+}
+
+void Headless::exportState() {
+	for(const auto& [id, device] : m_circuit.getDevices()) {
+		m_shm->publishDevice(id, *device);
+	}
+	m_shm->publishPins(m_board.getState());
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "board.h"
+#include "circuit.h"
+#include "shm-export.h"
+
+#include <factory/factory.h>
+
+#include <QObject>
+#include <QJsonObject>
+
+/**
+ * Runs a breadboard configuration without any widget: devices are loaded,
+ * placed at their graphics offset and connected by the same Circuit as in
+ * the GUI, but only updated on pin changes, as there is nothing to paint.
+ */
+class Headless : public QObject {
+	Q_OBJECT
+
+	Factory& m_factory;
+	Board m_board;		// declared first to outlive the circuit, which closes its IOFs on destruction
+	Circuit m_circuit;
+	std::unique_ptr<ShmExport> m_shm;
+
+	bool breadboardFromJSON(QJsonObject json);
+
+private slots:
+	void connectionEstablished();
+	void connectionLost();
+	void exportState();
+
+public:
+	Headless(Factory& factory, const std::string& host, const std::string& port);
+	~Headless();
+
+	void additionalLuaDir(const std::string& additional_device_dir, bool overwrite_integrated_devices);
+	bool loadJSON(const QString& file);
+	/**
+	 * Publishes device buffers and the pin register as /<prefix>-... shared memory
+	 */
+	void exportSharedMemory(const std::string& prefix);
+	void start();
+
+signals:
+	void finished();
+};
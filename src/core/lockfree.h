@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/**
+ * Single producer, single consumer snapshot: the producer always writes into
+ * its own back buffer and swaps it with the middle one on publish(), the
+ * consumer swaps the middle one into its front buffer. Neither side waits.
+ */
+template<typename T>
+class TripleBuffer {
+	static constexpr uint8_t index_mask = 0x3;
+	static constexpr uint8_t fresh = 0x4;
+
+	T m_buffers[3] = {};
+	std::atomic<uint8_t> m_middle{1};
+	uint8_t m_back = 0;		// producer only
+	uint8_t m_front = 2;	// consumer only
+
+public:
+	T& back() { return m_buffers[m_back]; }
+	void publish() {
+		m_back = m_middle.exchange(m_back | fresh, std::memory_order_acq_rel) & index_mask;
+	}
+
+	/**
+	 * @return true if front() changed since the last call
+	 */
+	bool update() {
+		if(!(m_middle.load(std::memory_order_relaxed) & fresh)) return false;
+		m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & index_mask;
+		return true;
+	}
+	const T& front() const { return m_buffers[m_front]; }
+};
+
+/**
+ * Bounded single producer, single consumer ring buffer. push and pop are
+ * wait-free, push fails if the queue is full.
+ */
+template<typename T, size_t N>
+class SPSCQueue {
+	static_assert(N && (N & (N-1)) == 0, "Queue size has to be a power of two");
+
+	T m_slots[N];
+	alignas(64) std::atomic<size_t> m_head{0};	// consumer
+	alignas(64) std::atomic<size_t> m_tail{0};	// producer
+
+public:
+	bool push(T&& value) {
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if(tail - m_head.load(std::memory_order_acquire) == N) return false;
+		m_slots[tail & (N-1)] = std::move(value);
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& value) {
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if(head == m_tail.load(std::memory_order_acquire)) return false;
+		value = std::move(m_slots[head & (N-1)]);
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+};
@@ -0,0 +1,71 @@
+#include "netlist.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+void Netlist::invalidate() {
+	m_valid = false;
+}
+
+bool Netlist::isValid() const {
+	return m_valid;
+}
+
+void Netlist::compile(const list<PinMapping>& reading, const list<PinMapping>& writing, const Devices& devices) {
+	m_slots.clear();
+	m_slot_ids.clear();
+	m_reading.clear();
+	m_writing.clear();
+
+	auto getSlot = [this, &devices](const DeviceID& id, Slot& slot) {
+		auto known = m_slot_ids.find(id);
+		if(known != m_slot_ids.end()) {
+			slot = known->second;
+			return true;
+		}
+		auto device = devices.find(id);
+		if(device == devices.end() || !device->second->m_pin) return false;
+		slot = m_slots.size();
+		m_slots.push_back(device->second.get());
+		m_slot_ids.emplace(id, slot);
+		return true;
+	};
+	auto toEntries = [&getSlot](const list<PinMapping>& mappings, vector<Entry>& entries) {
+		entries.reserve(mappings.size());
+		for(const auto& mapping : mappings) {
+			if(mapping.global_pin >= max_pins) {
+				cerr << "[Netlist] Global pin " << (int) mapping.global_pin << " exceeds pin register" << endl;
+				continue;
+			}
+			Slot slot;
+			if(!getSlot(mapping.device, slot)) continue;
+			entries.push_back(Entry{.slot = slot, .device_pin = mapping.device_pin, .global_pin = mapping.global_pin});
+		}
+	};
+	toEntries(reading, m_reading);
+	toEntries(writing, m_writing);
+
+	stable_sort(m_reading.begin(), m_reading.end(), [](const Entry& a, const Entry& b){return a.global_pin < b.global_pin;});
+	m_reading_ranges.fill(Range());
+	for(unsigned i = 0; i < m_reading.size(); i++) {
+		Range& range = m_reading_ranges[m_reading[i].global_pin];
+		if(range.begin == range.end) range.begin = i;
+		range.end = i + 1;
+	}
+
+	stable_sort(m_writing.begin(), m_writing.end(), [](const Entry& a, const Entry& b){return a.slot < b.slot;});
+	m_writing_ranges.assign(m_slots.size(), Range());
+	for(unsigned i = 0; i < m_writing.size(); i++) {
+		Range& range = m_writing_ranges[m_writing[i].slot];
+		if(range.begin == range.end) range.begin = i;
+		range.end = i + 1;
+	}
+
+	m_written.assign(m_writing.size(), nullopt);
+	m_touched.assign(m_slots.size(), 0);
+	m_touched_slots.clear();
+	m_touched_slots.reserve(m_slots.size());
+	m_valid = true;
+}
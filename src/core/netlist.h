@@ -0,0 +1,124 @@
+#pragma once
+
+#include <device.hpp>
+
+#include <array>
+#include <bit>
+#include <list>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Reading and writing pin connections compiled into dense arrays. Devices are
+ * addressed by slot, so propagating a pin change does not need any lookup by
+ * DeviceID. Has to be compiled again whenever connections or devices change.
+ */
+class Netlist {
+public:
+	typedef uint64_t PinRegister;
+	typedef unsigned Slot;
+	typedef std::unordered_map<DeviceID,std::unique_ptr<Device>> Devices;
+
+	struct PinMapping {
+		gpio::PinNumber global_pin;
+		Device::PIN_Interface::DevicePin device_pin;
+		DeviceID device;
+	};
+
+private:
+	struct Entry {
+		Slot slot;
+		Device::PIN_Interface::DevicePin device_pin;
+		gpio::PinNumber global_pin;
+	};
+
+	struct Range {
+		unsigned begin = 0;
+		unsigned end = 0;
+	};
+
+	static constexpr unsigned max_pins = sizeof(PinRegister)*8;
+
+	bool m_valid = false;
+	std::vector<Device*> m_slots;
+	std::unordered_map<DeviceID,Slot> m_slot_ids;
+	std::vector<Entry> m_reading;					// sorted by global pin
+	std::array<Range,max_pins> m_reading_ranges;	// per global pin
+	std::vector<Entry> m_writing;					// sorted by slot
+	std::vector<std::optional<gpio::Tristate>> m_written;	// per writing entry, last value sent
+	std::vector<Range> m_writing_ranges;			// per slot
+	std::vector<uint8_t> m_touched;					// per slot
+	std::vector<Slot> m_touched_slots;
+
+	template<typename SetBit>
+	void writeSlot(Slot slot, SetBit& setBit) {
+		const Range& range = m_writing_ranges[slot];
+		if(range.begin == range.end) return;
+		Device* device = m_slots[slot];
+		device->m_access.lock();
+		for(unsigned i = range.begin; i < range.end; i++) {
+			const gpio::Tristate val = device->m_pin->getPin(m_writing[i].device_pin);
+			if(m_written[i] == val) continue;
+			m_written[i] = val;
+			setBit(m_writing[i].global_pin, val);
+		}
+		device->m_access.unlock();
+	}
+
+public:
+	void invalidate();
+	bool isValid() const;
+	void compile(const std::list<PinMapping>& reading, const std::list<PinMapping>& writing, const Devices& devices);
+
+	/**
+	 * Sets all reading pins in changed, then writes the outputs of every device touched.
+	 * Outputs are only written if they differ from the last value written.
+	 * @param setBit called as setBit(gpio::PinNumber global, gpio::Tristate state)
+	 */
+	template<typename SetBit>
+	void propagate(PinRegister state, PinRegister changed, SetBit&& setBit) {
+		m_touched_slots.clear();
+		while(changed) {
+			const unsigned global = std::countr_zero(changed);
+			changed &= changed - 1;
+			const gpio::Tristate val = (state >> global)&1 ? gpio::Tristate::HIGH : gpio::Tristate::LOW;
+			const Range& range = m_reading_ranges[global];
+			for(unsigned i = range.begin; i < range.end; i++) {
+				const Entry& entry = m_reading[i];
+				Device* device = m_slots[entry.slot];
+				device->m_access.lock();
+				device->m_pin->setPin(entry.device_pin, val);
+				device->m_access.unlock();
+				if(!m_touched[entry.slot]) {
+					m_touched[entry.slot] = 1;
+					m_touched_slots.push_back(entry.slot);
+				}
+			}
+		}
+		// outputs may depend on the inputs that were just set
+		for(Slot slot : m_touched_slots) {
+			m_touched[slot] = 0;
+			writeSlot(slot, setBit);
+		}
+	}
+
+	template<typename SetBit>
+	void writeDevice(const DeviceID& id, SetBit&& setBit) {
+		auto slot = m_slot_ids.find(id);
+		if(slot == m_slot_ids.end()) return;
+		writeSlot(slot->second, setBit);
+	}
+
+	/**
+	 * Writes all outputs, regardless of the last values written (e.g. after reconnecting)
+	 */
+	template<typename SetBit>
+	void writeAll(SetBit&& setBit) {
+		m_written.assign(m_writing.size(), std::nullopt);
+		for(Slot slot = 0; slot < m_slots.size(); slot++) {
+			writeSlot(slot, setBit);
+		}
+	}
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <gpio-common.hpp>
+
+#include <bit>
+#include <cstdint>
+
+/**
+ * Levels of several pins written in one step, bit i refers to pin i.
+ * Pins in mask are HIGH if set in high, UNSET if set in unset and LOW otherwise.
+ */
+struct PinWrite {
+	typedef uint64_t PinRegister;
+	static constexpr unsigned max_pins = sizeof(PinRegister)*8;
+
+	PinRegister mask = 0;
+	PinRegister high = 0;
+	PinRegister unset = 0;
+
+	void set(unsigned pin, gpio::Tristate state) {
+		const PinRegister bit = static_cast<PinRegister>(1) << pin;
+		mask |= bit;
+		high = state == gpio::Tristate::HIGH ? high | bit : high & ~bit;
+		unset = state == gpio::Tristate::UNSET ? unset | bit : unset & ~bit;
+	}
+
+	gpio::Tristate get(unsigned pin) const {
+		if((unset >> pin) & 1) return gpio::Tristate::UNSET;
+		return (high >> pin) & 1 ? gpio::Tristate::HIGH : gpio::Tristate::LOW;
+	}
+
+	bool empty() const {
+		return !mask;
+	}
+
+	/**
+	 * Calls fun(pin, state) for every pin in mask, in ascending order
+	 */
+	template<typename Fun>
+	void forEach(Fun&& fun) const {
+		for(PinRegister rest = mask; rest; rest &= rest - 1) {
+			const unsigned pin = std::countr_zero(rest);
+			fun(pin, get(pin));
+		}
+	}
+};
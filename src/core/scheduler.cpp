@@ -0,0 +1,97 @@
+#include "scheduler.h"
+
+#include <QMetaObject>
+
+using namespace std;
+
+Scheduler::Scheduler() : QObject() {
+	m_timer.setSingleShot(true);
+	m_timer.setTimerType(Qt::PreciseTimer);
+	connect(&m_timer, &QTimer::timeout, this, &Scheduler::run);
+}
+
+Scheduler::~Scheduler() = default;
+
+void Scheduler::attach(Device* device) {
+	if(!device->m_timer) return;
+	{
+		lock_guard<mutex> lock(m_events_access);
+		m_attached.insert(device);
+	}
+	device->m_access.lock();
+	device->m_timer->setQueue(this);
+	device->m_access.unlock();
+}
+
+void Scheduler::detach(Device* device) {
+	if(!device->m_timer) return;
+	device->m_access.lock();
+	device->m_timer->setQueue(nullptr);
+	device->m_access.unlock();
+	lock_guard<mutex> lock(m_events_access);
+	m_attached.erase(device);
+	auto event = m_device_events.find(device);
+	if(event != m_device_events.end()) {
+		m_events.erase(event->second);
+		m_device_events.erase(event);
+	}
+}
+
+void Scheduler::wakeAt(Device* device, Time at) {
+	bool earliest;
+	{
+		lock_guard<mutex> lock(m_events_access);
+		if(!m_attached.contains(device)) return;
+		auto event = m_device_events.find(device);
+		if(event != m_device_events.end()) {
+			if(event->second->first <= at) return;
+			m_events.erase(event->second);
+		}
+		m_device_events[device] = m_events.emplace(at, device);
+		earliest = m_events.begin()->second == device;
+	}
+	if(earliest) {
+		// the timer belongs to the owning thread
+		QMetaObject::invokeMethod(this, &Scheduler::arm, Qt::QueuedConnection);
+	}
+}
+
+void Scheduler::arm() {
+	Time next;
+	{
+		lock_guard<mutex> lock(m_events_access);
+		if(m_events.empty()) {
+			m_timer.stop();
+			return;
+		}
+		next = m_events.begin()->first;
+	}
+	const Time delay = next - Device::Timer_Interface::now();
+	// round up, so the event is due when the timer fires
+	m_timer.start(delay.count() > 0 ? (delay.count() + 999) / 1000 : 0);
+}
+
+void Scheduler::run() {
+	const Time now = Device::Timer_Interface::now();
+	vector<Device*> due;
+	{
+		lock_guard<mutex> lock(m_events_access);
+		while(!m_events.empty() && m_events.begin()->first <= now) {
+			due.push_back(m_events.begin()->second);
+			m_device_events.erase(m_events.begin()->second);
+			m_events.erase(m_events.begin());
+		}
+	}
+	for(Device* device : due) {
+		{
+			// an earlier device may have caused this one to be removed
+			lock_guard<mutex> lock(m_events_access);
+			if(!m_attached.contains(device)) continue;
+		}
+		device->m_access.lock();
+		device->m_timer->onWakeup(now);
+		device->m_access.unlock();
+		emit(woken(device->getID()));
+	}
+	arm();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <device.hpp>
+
+#include <QObject>
+#include <QTimer>
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * Central event queue for timed device behaviour. Devices are left alone until
+ * their requested point of simulation time, the owning thread is only woken for
+ * the earliest pending event.
+ */
+class Scheduler : public QObject, public Device::Timer_Interface::Queue {
+	Q_OBJECT
+
+	typedef Device::Timer_Interface::Time Time;
+	typedef std::multimap<Time,Device*> Events;
+
+	QTimer m_timer;
+
+	std::mutex m_events_access;
+	Events m_events;
+	std::unordered_map<Device*,Events::iterator> m_device_events;	// only the earliest per device
+	std::unordered_set<Device*> m_attached;
+
+	void arm();
+
+private slots:
+	void run();
+
+public:
+	Scheduler();
+	~Scheduler();
+
+	/**
+	 * Lets the device request wakeups, if it implements the timer interface
+	 */
+	void attach(Device* device);
+	/**
+	 * Drops pending wakeups, has to be called before the device is destroyed
+	 */
+	void detach(Device* device);
+
+	void wakeAt(Device* device, Time at) override;
+
+signals:
+	void woken(const DeviceID& id);
+};
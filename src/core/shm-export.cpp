@@ -0,0 +1,191 @@
+#include "shm-export.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+using namespace std;
+
+ShmExport::ShmExport(const string& prefix) : m_prefix(escape(prefix)) {
+	m_pins.name = "/" + m_prefix + "-pins";
+}
+
+ShmExport::~ShmExport() {
+	for(auto& [id, segment] : m_devices) {
+		release(segment);
+	}
+	release(m_pins);
+}
+
+string ShmExport::escape(const string& name) {
+	string escaped;
+	for(char c : name) {
+		if(c == '%') escaped += "%25";
+		else if(c == '/') escaped += "%2F";
+		else escaped += c;
+	}
+	return escaped;
+}
+
+/**
+ * @return pid of the process that wrote the existing segment, 0 if it is not one of ours
+ */
+static pid_t getWriter(const string& name) {
+	const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if(fd < 0) return 0;
+	pid_t pid = 0;
+	struct stat info;
+	if(fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(ShmExport::ShmHeader)) {
+		void* map = mmap(nullptr, sizeof(ShmExport::ShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+		if(map != MAP_FAILED) {
+			const auto* header = static_cast<const ShmExport::ShmHeader*>(map);
+			if(header->magic == ShmExport::magic) {
+				pid = header->pid;
+			}
+			munmap(map, sizeof(ShmExport::ShmHeader));
+		}
+	}
+	close(fd);
+	return pid;
+}
+
+bool ShmExport::create(Segment& segment) {
+	segment.fd = shm_open(segment.name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if(segment.fd < 0 && errno == EEXIST) {
+		const pid_t writer = getWriter(segment.name);
+		if(writer && writer != getpid() && kill(writer, 0) != 0 && errno == ESRCH) {
+			// left by a run that did not clean up
+			shm_unlink(segment.name.c_str());
+			segment.fd = shm_open(segment.name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+		}
+		else {
+			cerr << "[ShmExport] " << segment.name << " is already used by " <<
+					(writer ? "process " + to_string(writer) : string("another program")) <<
+					", choose another prefix" << endl;
+			segment.taken = true;
+			return false;
+		}
+	}
+	if(segment.fd < 0) {
+		cerr << "[ShmExport] Could not create " << segment.name << ": " << strerror(errno) << endl;
+		return false;
+	}
+	return true;
+}
+
+bool ShmExport::reserve(Segment& segment, size_t size) {
+	if(segment.map && segment.size >= size) return true;
+	if(segment.taken) return false;
+	if(segment.fd < 0 && !create(segment)) {
+		return false;
+	}
+	if(segment.map) {
+		munmap(segment.map, segment.size);
+		segment.map = nullptr;
+	}
+	if(ftruncate(segment.fd, size) != 0) {
+		cerr << "[ShmExport] Could not resize " << segment.name << ": " << strerror(errno) << endl;
+		return false;
+	}
+	void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, segment.fd, 0);
+	if(map == MAP_FAILED) {
+		cerr << "[ShmExport] Could not map " << segment.name << ": " << strerror(errno) << endl;
+		return false;
+	}
+	const bool fresh = !segment.size;
+	segment.map = map;
+	segment.size = size;
+	if(fresh) {
+		auto* header = new (segment.map) ShmHeader{};
+		header->magic = magic;
+		header->version = version;
+		header->pid = getpid();
+	}
+	return true;
+}
+
+void ShmExport::release(Segment& segment) {
+	if(segment.map) {
+		munmap(segment.map, segment.size);
+	}
+	if(segment.fd >= 0) {
+		close(segment.fd);
+		shm_unlink(segment.name.c_str());
+	}
+	segment = Segment{.name = segment.name};
+}
+
+ShmExport::ShmHeader* ShmExport::beginWrite(Segment& segment) {
+	auto* header = static_cast<ShmHeader*>(segment.map);
+	header->sequence.store(header->sequence.load(memory_order_relaxed) + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	return header;
+}
+
+void ShmExport::endWrite(ShmHeader* header) {
+	header->sequence.store(header->sequence.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+void ShmExport::publishDevice(const DeviceID& id, Device& device) {
+	const uint64_t generation = device.getGeneration();
+	Segment& segment = m_devices[id];
+	if(segment.written && segment.generation == generation) return;
+	if(segment.name.empty()) {
+		segment.name = "/" + m_prefix + "-device-" + escape(id);
+	}
+
+	device.m_access.lock();
+	const QImage& buffer = device.getBuffer();
+	const size_t data_size = buffer.sizeInBytes();
+	const QVector<QRgb> palette = buffer.colorTable();
+	if(!reserve(segment, sizeof(ShmHeader) + data_size + palette.size() * sizeof(QRgb))) {
+		device.m_access.unlock();
+		return;
+	}
+	ShmHeader* header = beginWrite(segment);
+	header->format = buffer.format();
+	header->generation = device.getGeneration();
+	header->width = buffer.width();
+	header->height = buffer.height();
+	header->bytes_per_line = buffer.bytesPerLine();
+	header->data_size = data_size;
+	header->palette_size = palette.size();
+	uint8_t* data = reinterpret_cast<uint8_t*>(header + 1);
+	memcpy(data, buffer.constBits(), data_size);
+	memcpy(data + data_size, palette.constData(), palette.size() * sizeof(QRgb));
+	endWrite(header);
+	segment.generation = header->generation;
+	segment.written = true;
+	device.m_access.unlock();
+}
+
+void ShmExport::removeDevice(const DeviceID& id) {
+	auto segment = m_devices.find(id);
+	if(segment == m_devices.end()) return;
+	release(segment->second);
+	m_devices.erase(segment);
+}
+
+void ShmExport::publishPins(uint64_t state) {
+	if(!reserve(m_pins, sizeof(ShmHeader) + sizeof(state))) return;
+	ShmHeader* header = static_cast<ShmHeader*>(m_pins.map);
+	if(m_pins.written && memcmp(header + 1, &state, sizeof(state)) == 0) return;
+	header = beginWrite(m_pins);
+	header->format = 0;
+	header->generation = ++m_pins.generation;
+	header->width = 64;		// pins, bit i is global pin i
+	header->height = 1;
+	header->bytes_per_line = sizeof(state);
+	header->data_size = sizeof(state);
+	header->palette_size = 0;
+	memcpy(header + 1, &state, sizeof(state));
+	endWrite(header);
+	m_pins.written = true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <device.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Publishes device buffers and the pin register in POSIX shared memory, so
+ * external observers can read them at any rate without copying through the GUI.
+ * Segments are named /<prefix>-device-<id> and /<prefix>-pins, with '%' and '/'
+ * in prefix and id escaped as %25 and %2F. Each starts with a ShmHeader and is
+ * only written when its content changed. Segments are created exclusively:
+ * those left by a crashed run are replaced, those of a running one are not touched.
+ */
+class ShmExport {
+public:
+	static constexpr uint32_t magic = 0x53424256;	// "VBBS"
+	static constexpr uint32_t version = 2;
+
+	/**
+	 * Readers copy the content between two reads of sequence and retry if it was
+	 * odd or changed in between (seqlock). Segments only grow, readers have to map
+	 * again if sizeof(ShmHeader) + data_size + palette_size * 4 exceeds their mapping.
+	 */
+	struct ShmHeader {
+		uint32_t magic;
+		uint32_t version;
+		std::atomic<uint32_t> sequence;		// odd while written
+		uint32_t format;			// QImage::Format of the pixels, 0 for the pin register
+		uint64_t generation;		// increased on every change
+		uint32_t width;
+		uint32_t height;
+		uint32_t bytes_per_line;
+		uint32_t data_size;			// bytes following the header
+		uint32_t palette_size;		// QRgb entries following the data, for indexed formats
+		uint32_t pid;				// of the writing process
+	};
+	static_assert(std::atomic<uint32_t>::is_always_lock_free, "sequence has to be usable across processes");
+
+private:
+	struct Segment {
+		std::string name;
+		int fd = -1;
+		void* map = nullptr;
+		size_t size = 0;
+		uint64_t generation = 0;	// of the content written last
+		bool written = false;
+		bool taken = false;			// name used by another process, not retried
+	};
+
+	std::string m_prefix;
+	std::unordered_map<DeviceID,Segment> m_devices;
+	Segment m_pins;
+
+	static std::string escape(const std::string& name);
+	bool create(Segment& segment);
+	bool reserve(Segment& segment, size_t size);
+	void release(Segment& segment);
+	ShmHeader* beginWrite(Segment& segment);
+	void endWrite(ShmHeader* header);
+
+public:
+	ShmExport(const std::string& prefix);
+	~ShmExport();
+
+	/**
+	 * Copies the buffer if its generation changed, locks the device itself
+	 */
+	void publishDevice(const DeviceID& id, Device& device);
+	void removeDevice(const DeviceID& id);
+	void publishPins(uint64_t state);
+};
@@ -3,6 +3,7 @@
 #include <gpio-client.hpp>
 
 #include <list>
+#include <unordered_map>
 #include <QPoint>
 
 enum class IOFType {
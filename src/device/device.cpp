@@ -1,14 +1,16 @@
 #include "device.hpp"
 
-#include <breadboard/constants.h>
-
 #include <QKeySequence>
 #include <QJsonArray>
 #include <QPixmap>
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <iostream>
+#include <map>
 
-Device::Device(const DeviceID& id) : m_id(id) {}
+Device::Device(const DeviceID& id) : m_id(id), m_access(*this) {}
 
 Device::~Device() = default;
 
@@ -122,19 +124,102 @@ Device::Layout Device::getLayout() {
 void Device::initializeBuffer() {
 	QPoint offset = m_buffer.offset();
 	QSize size = m_buffer.size();
+	const QImage::Format format = m_buffer.format();
+	const QVector<QRgb> palette = m_buffer.colorTable();
 	m_buffer = QImage(":/img/default.png");
 	m_buffer = m_buffer.scaled(size);
+	if(!palette.isEmpty()) {
+		m_buffer = m_buffer.convertToFormat(format, palette);
+	} else if(format != QImage::Format_RGBA8888) {
+		m_buffer = m_buffer.convertToFormat(format);
+	}
 	m_buffer.setOffset(offset);
+	resetPaletteLookups();
+	markDirty();
+}
+
+QImage::Format Device::bufferFormat(const std::string& data_type) {
+	if(data_type == "rgba") return QImage::Format_RGBA8888;
+	if(data_type == "rgb565") return QImage::Format_RGB16;
+	if(data_type == "mono") return QImage::Format_MonoLSB;
+	if(data_type == "palette8") return QImage::Format_Indexed8;
+	std::cerr << "[Device] Unknown buffer data type '" << data_type << "', using rgba" << std::endl;
+	return QImage::Format_RGBA8888;
 }
 
 void Device::createBuffer(unsigned iconSizeMinimum, QPoint offset) {
 	if(!m_buffer.isNull()) return;
 	Layout layout = getLayout();
-	m_buffer = QImage(layout.width * iconSizeMinimum, layout.height * iconSizeMinimum, QImage::Format_RGBA8888);
+	const QImage::Format format = bufferFormat(layout.data_type);
+	m_buffer = QImage(layout.width * iconSizeMinimum, layout.height * iconSizeMinimum, format);
+	// Native formats are only expanded when painted, see Breadboard::paintEvent
+	if(format == QImage::Format_MonoLSB) {
+		m_buffer.setColorTable({qRgba(0, 0, 0, 255), qRgba(255, 255, 255, 255)});
+	} else if(format == QImage::Format_Indexed8) {
+		QVector<QRgb> grey(256);
+		for(int i = 0; i < grey.size(); i++) {
+			grey[i] = qRgba(i, i, i, 255);
+		}
+		m_buffer.setColorTable(grey);
+	}
 	m_buffer.setOffset(offset);
 	initializeBuffer();
 }
 
+bool Device::isRGBA() const {
+	return m_buffer.format() == QImage::Format_RGBA8888;
+}
+
+uint Device::toNative(Pixel p) const {
+	const QVector<QRgb> palette = m_buffer.colorTable();	// shared, not copied
+	if(palette.isEmpty()) {
+		return qRgba(p.r, p.g, p.b, p.a);
+	}
+	const QRgb colour = qRgba(p.r, p.g, p.b, p.a);
+	PaletteLookup& lookup = m_palette_lookups[(colour * 2654435761u) >> 24];
+	if(lookup.valid && lookup.colour == colour) {
+		return lookup.index;
+	}
+	uint nearest = 0;
+	int nearest_distance = INT_MAX;
+	for(int i = 0; i < palette.size(); i++) {
+		const QRgb c = palette[i];
+		const int distance = abs(qRed(c) - p.r) + abs(qGreen(c) - p.g) + abs(qBlue(c) - p.b) + abs(qAlpha(c) - p.a);
+		if(distance < nearest_distance) {
+			nearest = i;
+			nearest_distance = distance;
+		}
+	}
+	lookup = PaletteLookup{colour, nearest, true};
+	return nearest;
+}
+
+void Device::resetPaletteLookups() {
+	m_palette_lookups.fill(PaletteLookup{});
+}
+
+void Device::fillNative(unsigned x, unsigned y, unsigned x_end, unsigned y_end, uint value) {
+	for(unsigned row = y; row < y_end; row++) {
+		if(m_buffer.format() == QImage::Format_Indexed8) {
+			memset(m_buffer.scanLine(row) + x, value, x_end - x);
+			continue;
+		}
+		for(unsigned col = x; col < x_end; col++) {
+			m_buffer.setPixel(col, row, value);
+		}
+	}
+}
+
+void Device::setPaletteEntry(unsigned index, Pixel colour) {
+	if((int)index >= m_buffer.colorCount()) {
+		std::cerr << "[Device] WARN: palette index " << index << " out of range" << std::endl;
+		return;
+	}
+	m_buffer.setColor(index, qRgba(colour.r, colour.g, colour.b, colour.a));
+	resetPaletteLookups();
+	markDirty();
+}
+
 void Device::setScale(unsigned scale) {
 	m_scale = scale;
 }
@@ -145,17 +230,163 @@ QImage& Device::getBuffer() {
 	return m_buffer;
 }
 
+void Device::markDirty() {
+	m_generation.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t Device::getGeneration() const {
+	return m_generation.load(std::memory_order_acquire);
+}
+
+std::string Device::getStatistics() {
+	return "";
+}
+
 void Device::setPixel(const Xoffset x, const Yoffset y, Pixel p) {
 	auto* img = getBuffer().bits();
 	if(x >= m_buffer.width() || y >= m_buffer.height()) {
 		std::cerr << "[Device] WARN: device write accessing graphbuffer out of bounds!" << std::endl;
 		return;
 	}
+	if(!isRGBA()) {
+		m_buffer.setPixel(x, y, toNative(p));
+		markDirty();
+		return;
+	}
 	const auto offs = (y * m_buffer.width() + x) * 4; // heavily depends on rgba8888
 	img[offs+0] = p.r;
 	img[offs+1] = p.g;
 	img[offs+2] = p.b;
 	img[offs+3] = p.a;
+	markDirty();
+}
+
+Device::Pixel Device::unpack(PackedPixel p) {
+	return Pixel{
+		static_cast<uint8_t>(p >> 24),
+		static_cast<uint8_t>(p >> 16),
+		static_cast<uint8_t>(p >> 8),
+		static_cast<uint8_t>(p)
+	};
+}
+
+void Device::fillRect(const Xoffset x, const Yoffset y, unsigned width, unsigned height, Pixel p) {
+	const unsigned x_end = std::min<unsigned>(x + width, m_buffer.width());
+	const unsigned y_end = std::min<unsigned>(y + height, m_buffer.height());
+	if(x >= x_end || y >= y_end) return;
+	if(!isRGBA()) {
+		fillNative(x, y, x_end, y_end, toNative(p));
+		markDirty();
+		return;
+	}
+	const uint8_t rgba[4] = {p.r, p.g, p.b, p.a};
+	for(unsigned row = y; row < y_end; row++) {
+		uint8_t* line = m_buffer.scanLine(row) + x*4;	// heavily depends on rgba8888
+		for(unsigned col = x; col < x_end; col++, line += 4) {
+			memcpy(line, rgba, 4);
+		}
+	}
+	markDirty();
+}
+
+void Device::blit(const Xoffset x, const Yoffset y, unsigned width, unsigned height, const uint8_t* rgba) {
+	const unsigned x_end = std::min<unsigned>(x + width, m_buffer.width());
+	const unsigned y_end = std::min<unsigned>(y + height, m_buffer.height());
+	if(x >= x_end || y >= y_end) return;
+	if(!isRGBA()) {
+		uint32_t last_rgba = 0;
+		uint native = toNative(Pixel{0, 0, 0, 0});
+		for(unsigned row = y; row < y_end; row++) {
+			const uint8_t* src = rgba + (row - y) * width * 4;
+			for(unsigned col = x; col < x_end; col++, src += 4) {
+				uint32_t current;
+				memcpy(&current, src, 4);
+				if(current != last_rgba) {
+					last_rgba = current;
+					native = toNative(Pixel{src[0], src[1], src[2], src[3]});
+				}
+				m_buffer.setPixel(col, row, native);
+			}
+		}
+		markDirty();
+		return;
+	}
+	for(unsigned row = y; row < y_end; row++) {
+		memcpy(m_buffer.scanLine(row) + x*4, rgba + (row - y) * width * 4, (x_end - x) * 4);
+	}
+	markDirty();
+}
+
+void Device::setColumnBits(const Xoffset x, const Yoffset y, uint32_t bits, unsigned count, Pixel on, Pixel off) {
+	if(x >= (unsigned)m_buffer.width()) return;
+	const unsigned y_end = std::min<unsigned>(y + std::min(count, 32u), m_buffer.height());
+	if(!isRGBA()) {
+		const uint native_on = toNative(on);
+		const uint native_off = toNative(off);
+		for(unsigned row = y; row < y_end; row++, bits >>= 1) {
+			m_buffer.setPixel(x, row, bits & 1 ? native_on : native_off);
+		}
+		markDirty();
+		return;
+	}
+	const uint8_t rgba_on[4] = {on.r, on.g, on.b, on.a};
+	const uint8_t rgba_off[4] = {off.r, off.g, off.b, off.a};
+	for(unsigned row = y; row < y_end; row++, bits >>= 1) {
+		memcpy(m_buffer.scanLine(row) + x*4, bits & 1 ? rgba_on : rgba_off, 4);
+	}
+	markDirty();
+}
+
+std::shared_ptr<const Device::GlowMask> Device::getGlowMask(unsigned width, unsigned height) {
+	static std::mutex cache_access;
+	static std::map<std::pair<unsigned,unsigned>,std::shared_ptr<const GlowMask>> cache;
+	std::lock_guard<std::mutex> lock(cache_access);
+	auto& cached = cache[{width, height}];
+	if(cached) return cached;
+
+	auto mask = std::make_shared<GlowMask>(GlowMask{width, height, std::vector<uint8_t>(width * height)});
+	const int center = std::ceil(std::min(width, height) / 2.);
+	for(unsigned y = 0; y < height; y++) {
+		for(unsigned x = 0; x < width; x++) {
+			const float dist = std::hypot(center - (int)(x+1), center - (int)(y+1));
+			const int lumen = std::floor((1 - dist/center) * 255);
+			mask->alpha[y * width + x] = std::clamp(lumen, 0, 255);
+		}
+	}
+	cached = mask;
+	return cached;
+}
+
+void Device::fillGlow(Pixel colour) {
+	const unsigned width = m_buffer.width();
+	const unsigned height = m_buffer.height();
+	if(!m_glow_mask || m_glow_mask->width != width || m_glow_mask->height != height) {
+		m_glow_mask = getGlowMask(width, height);
+	}
+	const uint8_t* alpha = m_glow_mask->alpha.data();
+	if(!isRGBA()) {
+		// no alpha channel, the glow darkens the colour instead
+		for(unsigned row = 0; row < height; row++, alpha += width) {
+			for(unsigned col = 0; col < width; col++) {
+				m_buffer.setPixel(col, row, toNative(Pixel{
+					(uint8_t)(colour.r * alpha[col] / 255), (uint8_t)(colour.g * alpha[col] / 255),
+					(uint8_t)(colour.b * alpha[col] / 255), 255}));
+			}
+		}
+		markDirty();
+		return;
+	}
+	for(unsigned row = 0; row < height; row++) {
+		uint8_t* line = m_buffer.scanLine(row);	// heavily depends on rgba8888
+		for(unsigned col = 0; col < width; col++, line += 4) {
+			line[0] = colour.r;
+			line[1] = colour.g;
+			line[2] = colour.b;
+			line[3] = (alpha[col] * colour.a + 127) / 255;
+		}
+		alpha += width;
+	}
+	markDirty();
 }
 
 Device::Pixel Device::getPixel(const Xoffset x, const Yoffset y) {
@@ -164,6 +395,10 @@ Device::Pixel Device::getPixel(const Xoffset x, const Yoffset y) {
 		std::cerr << "[Device] WARN: device read accessing graphbuffer out of bounds!" << std::endl;
 		return Pixel{0,0,0,0};
 	}
+	if(!isRGBA()) {
+		const QRgb c = m_buffer.pixel(x, y);
+		return Pixel{(uint8_t)qRed(c), (uint8_t)qGreen(c), (uint8_t)qBlue(c), (uint8_t)qAlpha(c)};
+	}
 	const auto& offs = (y * m_buffer.width() + x) * 4; // heavily depends on rgba8888
 	return Pixel{
 		static_cast<uint8_t>(img[offs+0]),
@@ -174,9 +409,25 @@ Device::Pixel Device::getPixel(const Xoffset x, const Yoffset y) {
 }
 
 Device::PIN_Interface::~PIN_Interface() = default;
+
+const Device::PIN_Interface::PinDesc* Device::PIN_Interface::getPinDesc(DevicePin num) {
+	const PinLayout& layout = getPinLayout();
+	auto desc = layout.find(num);
+	return desc != layout.end() ? &desc->second : nullptr;
+}
+
 Device::SPI_Interface::~SPI_Interface() = default;
 Device::Config_Interface::~Config_Interface() = default;
 Device::Input_Interface::~Input_Interface() = default;
+Device::Timer_Interface::~Timer_Interface() = default;
+Device::Timer_Interface::Queue::~Queue() = default;
+
+void Device::SPI_Interface::sendBurst(const gpio::SPI_Command* bytes, size_t count, gpio::SPI_Response* responses) {
+	for(size_t i = 0; i < count; i++) {
+		const gpio::SPI_Response response = send(bytes[i]);
+		if(responses) responses[i] = response;
+	}
+}
 
 void Device::Input_Interface::setKeys(Keys bindings) {
 	keybindings = bindings;
@@ -185,3 +436,76 @@ void Device::Input_Interface::setKeys(Keys bindings) {
 Keys Device::Input_Interface::getKeys() const {
 	return keybindings;
 }
+
+/* Timer Interface */
+
+Device::Timer_Interface::Timer_Interface(Device* device) : m_device(device) {}
+
+Device::Timer_Interface::Time Device::Timer_Interface::now() {
+	static const auto start = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<Time>(std::chrono::steady_clock::now() - start);
+}
+
+void Device::Timer_Interface::setQueue(Queue* queue) {
+	m_queue = queue;
+	if(m_queue && m_pending) {
+		m_queue->wakeAt(m_device, *m_pending);
+		m_pending.reset();
+	}
+}
+
+void Device::Timer_Interface::wakeAt(Time at) {
+	if(m_queue) {
+		m_queue->wakeAt(m_device, at);
+	}
+	else if(!m_pending || at < *m_pending) {
+		m_pending = at;
+	}
+}
+
+/* Access */
+
+Device::Access::Access(Device& device) : m_device(device) {}
+
+void Device::Access::lock() {
+	m_mutex.lock();
+	m_device.deliverSPI();
+}
+
+void Device::Access::unlock() {
+	m_mutex.unlock();
+}
+
+/* SPI queue */
+
+void Device::queueSPI(gpio::SPI_Command byte) {
+	bool full;
+	{
+		std::lock_guard<std::mutex> lock(m_spi_queue_access);
+		m_spi_queue.push_back(byte);
+		m_spi_queued = true;
+		full = m_spi_queue.size() >= max_queued_spi;
+	}
+	if(full) {
+		flushSPI();
+	}
+}
+
+void Device::flushSPI() {
+	if(!m_spi_queued) return;
+	m_access.lock();	// delivers the queue
+	m_access.unlock();
+}
+
+void Device::deliverSPI() {
+	if(!m_spi_queued) return;
+	{
+		std::lock_guard<std::mutex> lock(m_spi_queue_access);
+		m_spi_burst.swap(m_spi_queue);
+		m_spi_queued = false;
+	}
+	if(m_spi) {
+		m_spi->sendBurst(m_spi_burst.data(), m_spi_burst.size(), nullptr);
+	}
+	m_spi_burst.clear();
+}
@@ -3,11 +3,16 @@
 
 #include <gpio-common.hpp>
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <optional>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
 
 #include <QImage>
 #include <QJsonObject>
@@ -27,7 +32,7 @@ protected:
 	struct Layout {
 		unsigned width = 5; // as raster rows
 		unsigned height = 5; // as raster indexes
-		std::string data_type = "rgba";	// Currently ignored and always RGBA8888
+		std::string data_type = "rgba";	// rgba (RGBA8888), rgb565, mono (1 bpp) or palette8
 	};
 
 	// TODO: Add a scheme that only alpha channel is changed?
@@ -43,7 +48,25 @@ protected:
 	};
 	void setPixel(const Xoffset, const Yoffset, Pixel);
 	Pixel getPixel(const Xoffset, const Yoffset);
+
+	// Bulk access, clipped to the buffer
+	typedef uint32_t PackedPixel;	// 0xRRGGBBAA
+	static Pixel unpack(PackedPixel p);
+	void fillRect(const Xoffset, const Yoffset, unsigned width, unsigned height, Pixel);
+	void blit(const Xoffset, const Yoffset, unsigned width, unsigned height, const uint8_t* rgba);	// rows of rgba8888
+	void setColumnBits(const Xoffset, const Yoffset, uint32_t bits, unsigned count, Pixel on, Pixel off);	// LSB on top
+	/**
+	 * Fills the buffer with colour, its alpha scaled by a radial mask that fades from
+	 * the center to the edge of the largest circle in the top left corner (LED glow).
+	 * The mask is computed once per buffer size and shared between devices.
+	 */
+	void fillGlow(Pixel colour);
+	/**
+	 * Colour of a palette index in mono (0 and 1) and palette8 buffers, ignored otherwise
+	 */
+	void setPaletteEntry(unsigned index, Pixel colour);
 	virtual Layout getLayout();
+	void markDirty();	// has to be called after writing into m_buffer directly
 
 public:
 
@@ -58,6 +81,15 @@ public:
 	void setScale(unsigned scale);
 	unsigned getScale() const;
 	QImage& getBuffer();
+	/**
+	 * Increased whenever the buffer content changes, may be read without m_access
+	 */
+	uint64_t getGeneration() const;
+	/**
+	 * Human readable runtime statistics (e.g. time spent in scripts), empty if none.
+	 * Has to be called with m_access locked.
+	 */
+	virtual std::string getStatistics();
 
 	class PIN_Interface {
 	public:
@@ -77,7 +109,14 @@ public:
 		typedef std::unordered_map<DevicePin,PinDesc> PinLayout;
 
 		virtual ~PIN_Interface();
-		virtual PinLayout getPinLayout() = 0;
+		/**
+		 * Only valid while the device is locked, copy it to use it afterwards
+		 */
+		virtual const PinLayout& getPinLayout() = 0;
+		/**
+		 * @return nullptr if the device does not offer the pin, same validity as getPinLayout
+		 */
+		virtual const PinDesc* getPinDesc(DevicePin num);
 		virtual gpio::Tristate getPin(DevicePin num) = 0;
 		virtual void setPin(DevicePin num, gpio::Tristate val) = 0;
 	};
@@ -86,6 +125,11 @@ public:
 	public:
 		virtual ~SPI_Interface();
 		virtual gpio::SPI_Response send(gpio::SPI_Command byte) = 0;
+		/**
+		 * Several bytes in a row, responses may be nullptr if they are not needed.
+		 * Sends byte by byte unless overridden.
+		 */
+		virtual void sendBurst(const gpio::SPI_Command* bytes, size_t count, gpio::SPI_Response* responses);
 	};
 
 	class Config_Interface {
@@ -105,15 +149,120 @@ public:
 		Keys getKeys() const;
 	};
 
+	/**
+	 * Timed behaviour: a device requests to be woken at a point of simulation time
+	 * and is not called in between.
+	 */
+	class Timer_Interface {
+	public:
+		typedef std::chrono::microseconds Time;
+
+		/**
+		 * Event queue of the owner, keeps only the earliest wakeup of every device
+		 */
+		class Queue {
+		public:
+			virtual ~Queue();
+			/**
+			 * May be called from any thread
+			 */
+			virtual void wakeAt(Device* device, Time at) = 0;
+		};
+
+		Timer_Interface(Device* device);
+		virtual ~Timer_Interface();
+		/**
+		 * Simulation time, counted from program start and shared by all devices
+		 */
+		static Time now();
+		/**
+		 * Called by the queue with the device locked. The device has to request
+		 * its next wakeup again, if it still needs one.
+		 */
+		virtual void onWakeup(Time now) = 0;
+		/**
+		 * Call with the device locked, nullptr detaches it
+		 */
+		void setQueue(Queue* queue);
+
+	protected:
+		/**
+		 * Requested before a queue is set, the earliest request is passed on later
+		 */
+		void wakeAt(Time at);
+
+	private:
+		Device* m_device;
+		Queue* m_queue = nullptr;
+		std::optional<Time> m_pending;
+	};
+
 
 	std::unique_ptr<PIN_Interface> m_pin;
 	std::unique_ptr<SPI_Interface> m_spi;
 	std::unique_ptr<Config_Interface> m_conf;
 	std::unique_ptr<Input_Interface> m_input;
+	std::unique_ptr<Timer_Interface> m_timer;
+
+	/**
+	 * Held by the owner while calling into the device, may be called from the GPIO thread.
+	 * Locking first delivers the SPI bytes queued by queueSPI.
+	 */
+	class Access {
+		Device& m_device;
+		std::mutex m_mutex;
+	public:
+		Access(Device& device);
+		void lock();
+		void unlock();
+	};
+	Access m_access;
+
+	/**
+	 * For SPI channels without responses: bytes are collected and handed to
+	 * m_spi->sendBurst together on the next lock of m_access, so they are
+	 * still delivered before anything else touches the device.
+	 */
+	void queueSPI(gpio::SPI_Command byte);
+	void flushSPI();
 
 	Device(const DeviceID& id);
 	virtual ~Device();
 
 private:
+	static constexpr size_t max_queued_spi = 1024;	// e.g. one page-wise OLED frame
+
 	unsigned m_scale = 1;
+	std::atomic<uint64_t> m_generation = 0;
+
+	struct GlowMask {
+		unsigned width;
+		unsigned height;
+		std::vector<uint8_t> alpha;		// row major
+	};
+	std::shared_ptr<const GlowMask> m_glow_mask;	// of the current buffer size
+	static std::shared_ptr<const GlowMask> getGlowMask(unsigned width, unsigned height);
+
+	static QImage::Format bufferFormat(const std::string& data_type);
+	bool isRGBA() const;
+	/**
+	 * @return p as value for QImage::setPixel, the nearest palette index for indexed buffers
+	 */
+	uint toNative(Pixel p) const;
+	struct PaletteLookup {
+		QRgb colour = 0;
+		uint index = 0;
+		bool valid = false;
+	};
+	// direct mapped cache of nearest palette indexes, reset whenever the palette changes
+	mutable std::array<PaletteLookup, 256> m_palette_lookups;
+	void resetPaletteLookups();
+	void fillNative(unsigned x, unsigned y, unsigned x_end, unsigned y_end, uint value);
+
+	std::mutex m_spi_queue_access;
+	std::atomic<bool> m_spi_queued = false;
+	std::vector<gpio::SPI_Command> m_spi_queue;
+	std::vector<gpio::SPI_Command> m_spi_burst;		// only used with m_access held
+
+	void deliverSPI();
 };
@@ -11,6 +11,7 @@ public:
 
 	template <typename Derived>
 	bool registerDeviceType() {
+		static_assert(Derived::descriptor.isValid(), "pins of the device descriptor have to be unique and on the device");
 		return m_deviceCreators.insert(std::make_pair(Derived::m_classname, [](DeviceID id) {return std::make_unique<Derived>(id);})).second;
 	}
 
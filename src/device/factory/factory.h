@@ -15,5 +15,8 @@ public:
 	std::list<DeviceClass> getCDevices();
 
 	bool deviceExists(const DeviceClass& classname);
+	/**
+	 * @return nullptr if a scripted device turns out to be invalid on instantiation
+	 */
 	std::unique_ptr<Device> instantiateDevice(const DeviceID& id, const DeviceClass& classname);
 };
@@ -27,12 +27,93 @@ local cage = {
 --local mt = {__index=cage}
 local mt = {__index=_G} 
 
+-- Lua 5.1 and LuaJIT set the environment of a chunk with setfenv
+local function load_in_env (script, name, env)
+  if setfenv then
+    local chunk, error = loadstring (script, name)
+    if chunk then setfenv (chunk, env) end
+    return chunk, error
+  end
+  return load (script, name, "bt", env)
+end
+
+local function loadfile_in_env (scriptname, env)
+  if setfenv then
+    local chunk, error = loadfile (scriptname)
+    if chunk then setfenv (chunk, env) end
+    return chunk, error
+  end
+  return loadfile (scriptname, "bt", env)
+end
+
+--[[
+Timed behaviour: spawn (fun, ...) runs fun as a task until it calls sleep (ms),
+which resumes it after ms milliseconds of simulation time (see simulation_time ()).
+Sleeping tasks cost nothing, the device is only woken for the next one that is due.
+Only scripts with a task left after loading get a timer, so tasks have to be
+spawned while the script loads (a task may sleep for long to keep it).
+--]]
+local tasks = {}  -- sleeping task -> wakeup in ms
+
+function _has_tasks ()
+  return next (tasks) ~= nil
+end
+
+function _next_task_wakeup ()
+  local next
+  for _, at in pairs (tasks) do
+    if not next or at < next then next = at end
+  end
+  return next
+end
+
+local function request_next_wakeup ()
+  local next = _next_task_wakeup ()
+  -- provided once the device exists, it asks for _next_task_wakeup () itself
+  if next and _request_wakeup then _request_wakeup (next) end
+end
+
+local function resume_task (task, ...)
+  local ok, delay = coroutine.resume (task, ...)
+  if not ok then
+    print ("task failed: " .. tostring (delay))
+  elseif coroutine.status (task) ~= "dead" then
+    tasks[task] = simulation_time () + (tonumber (delay) or 0)
+  end
+end
+
+function spawn (fun, ...)
+  resume_task (coroutine.create (fun), ...)
+  request_next_wakeup ()
+end
+
+function sleep (ms)
+  local task, main = coroutine.running ()
+  if not task or main then
+    error ("sleep is only possible in a task started with spawn", 2)
+  end
+  coroutine.yield (ms)
+end
+
+function _run_due_tasks (now)
+  local due = {}
+  for task, at in pairs (tasks) do
+    if at <= now then due[#due + 1] = task end
+  end
+  table.sort (due, function (a, b) return tasks[a] < tasks[b] end)
+  for _, task in ipairs (due) do
+    tasks[task] = nil
+    resume_task (task)
+  end
+  request_next_wakeup ()
+end
+
 function scriptloader_file (scriptname)
   -- print( "scriptloader_file loading " .. scriptname )
   local scriptenv = {}
   setmetatable (scriptenv, mt)
   
-  chunk, error = loadfile (scriptname, "bt", scriptenv)
+  chunk, error = loadfile_in_env (scriptname, scriptenv)
   if not chunk then
     print(error)
   else
@@ -49,7 +130,7 @@ function scriptloader_string (script, name)
   -- print("loading string")
   -- print(script)
   
-  chunk, error = load (script, name, "bt", scriptenv)
+  chunk, error = load_in_env (script, name, scriptenv)
   if not chunk then
     print(error)
   else
@@ -6,9 +6,14 @@
  */
 #include "luaFactory.hpp"
 #include "errors.h"
+#include <interface/luaAllocator.hpp>
 extern "C"
 {
-#if __has_include(<lua5.3/lua.h>)
+#if defined(USE_LUAJIT)
+	#include <lua.h>
+	#include <lualib.h>
+	#include <lauxlib.h>
+#elif __has_include(<lua5.3/lua.h>)
 	#include <lua5.3/lua.h>
 	#include <lua5.3/lualib.h>
 	#include <lua5.3/lauxlib.h>
@@ -23,10 +28,15 @@ extern "C"
 #include <LuaBridge/LuaBridge.h>
 
 #include <QDirIterator>
+#include <QFileInfo>
 
 #include <filesystem>
 #include <exception>
 #include <memory> // unique_ptr
+#include <atomic>
+#include <future>
+#include <regex>
+#include <thread>
 
 
 using std::cout;
@@ -44,13 +54,58 @@ using std::filesystem::path;
 using std::filesystem::directory_iterator;
 
 
-static lua_State* L;
+static lua_State* L;	// only for scanning scripts, every device gets its own state
+
+#if !defined(USE_LUAJIT)
+/*
+ * LuaJIT's bit library for Lua 5.3, so scripts do not depend on the 5.3 bitwise
+ * operators. Same 32 bit semantics: results are normalized to signed 32 bit.
+ */
+static uint32_t checkBits(lua_State* L, int arg) {
+	return static_cast<uint32_t>(static_cast<int64_t>(luaL_checknumber(L, arg)));
+}
+
+static int pushBits(lua_State* L, uint32_t bits) {
+	lua_pushinteger(L, static_cast<int32_t>(bits));
+	return 1;
+}
+
+template<typename Op>
+static int foldBits(lua_State* L, Op op) {
+	uint32_t bits = checkBits(L, 1);
+	for(int arg = 2; arg <= lua_gettop(L); arg++) {
+		bits = op(bits, checkBits(L, arg));
+	}
+	return pushBits(L, bits);
+}
+
+static const luaL_Reg bit_functions[] = {
+	{"tobit", [](lua_State* L){ return pushBits(L, checkBits(L, 1)); }},
+	{"bnot", [](lua_State* L){ return pushBits(L, ~checkBits(L, 1)); }},
+	{"band", [](lua_State* L){ return foldBits(L, [](uint32_t a, uint32_t b){ return a & b; }); }},
+	{"bor", [](lua_State* L){ return foldBits(L, [](uint32_t a, uint32_t b){ return a | b; }); }},
+	{"bxor", [](lua_State* L){ return foldBits(L, [](uint32_t a, uint32_t b){ return a ^ b; }); }},
+	{"lshift", [](lua_State* L){ return pushBits(L, checkBits(L, 1) << (checkBits(L, 2) & 31)); }},
+	{"rshift", [](lua_State* L){ return pushBits(L, checkBits(L, 1) >> (checkBits(L, 2) & 31)); }},
+	{"arshift", [](lua_State* L){
+		return pushBits(L, static_cast<uint32_t>(static_cast<int32_t>(checkBits(L, 1)) >> (checkBits(L, 2) & 31)));
+	}},
+	{nullptr, nullptr}
+};
+
+static void openBitLibrary(lua_State* L) {
+	luaL_newlib(L, bit_functions);
+	lua_setglobal(L, "bit");
+}
+#endif
 
 /**
  * @return [false, ...] if invalid
  */
 LuaRef loadScriptFromFile(lua_State* L, path p) {
 	LuaRef scriptloader = getGlobal(L, "scriptloader_file");
+	// top level code of the script runs here, so it is limited like any other call
+	LuaDevice::Watchdog::Call call(LuaDevice::Watchdog::of(L));
 	try {
 		LuaResult r = scriptloader(p.c_str());
 		if(!r.wasOk()) {
@@ -79,24 +134,26 @@ LuaRef loadScriptFromFile(lua_State* L, path p) {
  */
 LuaRef loadScriptFromString(lua_State* L, std::string p, std::string name = "external script") {
 	LuaRef scriptloader = getGlobal(L, "scriptloader_string");
+	// top level code of the script runs here, so it is limited like any other call
+	LuaDevice::Watchdog::Call call(LuaDevice::Watchdog::of(L));
 	try {
 		LuaResult r = scriptloader(p, name);
 		if(!r.wasOk()) {
-			cerr << p << ": " << r.errorMessage() << endl;
+			cerr << name << ": " << r.errorMessage() << endl;
 			return LuaRef(L);
 		}
 		if(r.size() != 1) {
-			//cerr << p << " failed." << endl;
+			//cerr << name << " failed." << endl;
 			return LuaRef(L);
 		}
 		if(!r[0].isTable()) {
-			cerr << p << ": " << r[0] << endl;
+			cerr << name << ": " << r[0] << endl;
 			return LuaRef(L);
 		}
 		return r[0];
 
 	} catch(LuaException& e)	{
-		cerr << "serious shit got down in string \n" << p << endl;
+		cerr << "serious shit got down in script " << name << endl;
 		cerr << e.what() << endl;
 		return LuaRef(L);
 	}
@@ -115,51 +172,197 @@ bool isScriptValidDevice(LuaRef& chunk, std::string name = "") {
 }
 
 LuaFactory::LuaFactory(){
-	L = luaL_newstate();
-	luaL_openlibs(L);
-
 	QFile loader(m_scriptloader.c_str());
 	if (!loader.open(QIODevice::ReadOnly)) {
 		throw(runtime_error("Could not open scriptloader at " + m_scriptloader));
 	}
-	QByteArray loader_content = loader.readAll();
+	m_scriptloader_content = loader.readAll();
+
+	L = createState();
+
+	//cout << "Scanning built-in devices..." << endl;
+
+	scanDir(m_builtin_scripts);
+}
 
-	if( luaL_dostring( L, loader_content) )
+lua_State* LuaFactory::createState() {
+	lua_State* state = LuaAllocator::newState();
+	LuaDevice::Watchdog::install(state);	// before any script runs or creates a coroutine
+	luaL_openlibs(state);	// LuaJIT opens its bit library here
+#if !defined(USE_LUAJIT)
+	openBitLibrary(state);
+#endif
+	LuaDevice::PIN_Interface_Lua::declarePinStates(state);
+	LuaDevice::Timer_Interface_Lua::declareSimulationTime(state);
+
+	// the scriptloader may be bytecode, which is not null-terminated text
+	if( luaL_loadbuffer( state, m_scriptloader_content.constData(), m_scriptloader_content.size(), "loadscript") ||
+		lua_pcall( state, 0, LUA_MULTRET, 0) )
 	{
 		cerr << "Error loading loadscript:\n" <<
-				 lua_tostring( L, lua_gettop( L ) ) << endl;
-		lua_pop( L, 1 );
+				 lua_tostring( state, lua_gettop( state ) ) << endl;
+		LuaAllocator::close( state );
 		throw(runtime_error("Loadscript not valid"));
 	}
+	return state;
+}
 
-	//cout << "Scanning built-in devices..." << endl;
+static int appendChunk(lua_State*, const void* data, size_t size, void* chunk) {
+	static_cast<std::string*>(chunk)->append(static_cast<const char*>(data), size);
+	return 0;
+}
 
-	scanDir(m_builtin_scripts);
+const std::string& LuaFactory::getCompiledScript(const std::string& filepath) {
+	const QDateTime modified = QFileInfo(filepath.c_str()).lastModified();
+	auto cached = m_compiled_scripts.find(filepath);
+	if(cached != m_compiled_scripts.end() && cached->second.modified == modified) {
+		return cached->second.chunk;
+	}
+
+	QFile script_file(filepath.c_str());
+	if (!script_file.open(QIODevice::ReadOnly)) {
+		throw(runtime_error("Could not open file " + filepath));
+	}
+	const QByteArray script = script_file.readAll();
+
+	CompiledScript& compiled = m_compiled_scripts[filepath];
+	compiled.modified = modified;
+	compiled.chunk.clear();
+	if(script.startsWith(LUA_SIGNATURE[0])) {
+		compiled.chunk.assign(script.constData(), script.size());
+		return compiled.chunk;
+	}
+	const std::string chunkname = "@" + filepath;
+	if(luaL_loadbuffer(L, script.constData(), script.size(), chunkname.c_str())) {
+		cerr << "[lua] " << lua_tostring(L, -1) << endl;
+#if defined(USE_LUAJIT)
+		cerr << "[lua]\tLuaJIT does not know the Lua 5.3 operators << >> & | ~ //, use the bit library instead" << endl;
+#endif
+		lua_pop(L, 1);
+		return compiled.chunk;
+	}
+#if defined(USE_LUAJIT)
+	lua_dump(L, appendChunk, &compiled.chunk);
+#else
+	lua_dump(L, appendChunk, &compiled.chunk, 0);	// keep debug information for error messages
+#endif
+	lua_pop(L, 1);
+	return compiled.chunk;
+}
+
+/**
+ * Header convention: the first statement of a device script is `classname = "<name>"`,
+ * only preceded by blank lines and line comments.
+ * @return the classname, if the script follows the convention
+ */
+static std::optional<std::string> readClassname(const QByteArray& script) {
+	static const std::regex header(R"(\s*classname\s*=\s*(["'])([^"'\\]*)\1\s*;?\s*(--.*)?)");
+	static const std::regex skipped(R"(\s*(--(?!\[=*\[).*)?)");
+	if(script.startsWith(LUA_SIGNATURE[0])) return std::nullopt;	// bytecode
+	for(const QByteArray& line : script.split('\n')) {
+		const std::string text = line.trimmed().toStdString();
+		std::smatch match;
+		if(std::regex_match(text, match, header)) return match[2].str();
+		if(!std::regex_match(text, skipped)) return std::nullopt;
+	}
+	return std::nullopt;
+}
+
+/**
+ * Precompiled scripts have their classnames listed in a classnames.txt of their
+ * directory, one "<filename> <classname>" per line, generated at build time
+ */
+static std::unordered_map<std::string, std::string> readClassnameManifest(const std::string& dir) {
+	std::unordered_map<std::string, std::string> classnames;
+	QFile manifest((dir + "/classnames.txt").c_str());
+	if(!manifest.open(QIODevice::ReadOnly)) return classnames;
+	for(const QByteArray& line : manifest.readAll().split('\n')) {
+		const QList<QByteArray> entry = line.trimmed().split(' ');
+		if(entry.size() != 2) continue;
+		classnames.emplace(entry[0].toStdString(), entry[1].toStdString());
+	}
+	return classnames;
+}
+
+std::vector<LuaFactory::DiscoveredScript> LuaFactory::discoverScripts(const std::vector<std::string>& files) {
+	std::vector<DiscoveredScript> discovered(files.size());
+	std::atomic<size_t> next = 0;
+	auto worker = [&files, &discovered, &next]() {
+		for(size_t i = next++; i < files.size(); i = next++) {
+			QFile script_file(files[i].c_str());
+			discovered[i].readable = script_file.open(QIODevice::ReadOnly);
+			if(discovered[i].readable) {
+				discovered[i].classname = readClassname(script_file.readAll());
+			}
+		}
+	};
+	const size_t num_workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), files.size());
+	std::vector<std::future<void>> workers;
+	for(size_t i = 0; i < num_workers; i++) {
+		workers.push_back(std::async(std::launch::async, worker));
+	}
+	for(auto& running : workers) {
+		running.get();
+	}
+	return discovered;
+}
+
+std::optional<std::string> LuaFactory::executeForClassname(const std::string& filepath, const std::string& filename) {
+	const std::string& script = getCompiledScript(filepath);
+	if(script.empty())
+		return std::nullopt;
+
+	auto chunk = loadScriptFromString(L, script, filename);
+	if(!isScriptValidDevice(chunk, filepath))
+		return std::nullopt;
+	const auto maybe_classname = chunk["classname"].cast<std::string>();
+	if(!maybe_classname) {
+		cerr << "[lua] Warn: script does not state a classname at '" << filepath << "'" << endl;
+		cerr << "\tError code is: " << maybe_classname.message() << endl;
+		return std::nullopt;
+	}
+	return maybe_classname.value();
 }
 
 void LuaFactory::scanDir(std::string dir, bool overwrite_existing) {
 	QDirIterator it(dir.c_str(),
 			QStringList() << "*.lua",
 			QDir::Files, QDirIterator::Subdirectories);
+	std::vector<std::string> files;
+	std::vector<std::string> filenames;
+	std::vector<std::string> dirs;
 	while (it.hasNext()) {
 		it.next();
 		//cout << "\t" << it.fileName().toStdString() << endl;
-		QFile script_file(it.filePath());
-		if (!script_file.open(QIODevice::ReadOnly)) {
-			throw(runtime_error("Could not open file " + it.fileName().toStdString()));
-		}
-		QByteArray script = script_file.readAll();
-		const auto filepath = it.filePath().toStdString();
+		files.push_back(it.filePath().toStdString());
+		filenames.push_back(it.fileName().toStdString());
+		dirs.push_back(it.fileInfo().path().toStdString());
+	}
+	const std::vector<DiscoveredScript> discovered = discoverScripts(files);
+	std::unordered_map<std::string, std::unordered_map<std::string, std::string>> manifests;
 
-		auto chunk = loadScriptFromString(L, script.toStdString(), it.fileName().toStdString());
-		if(!isScriptValidDevice(chunk, filepath))
-			continue;
-		const auto maybe_classname = chunk["classname"].cast<std::string>();
+	for(size_t i = 0; i < files.size(); i++) {
+		const auto& filepath = files[i];
+		if(!discovered[i].readable) {
+			throw(runtime_error("Could not open file " + filenames[i]));
+		}
+		auto maybe_classname = discovered[i].classname;
 		if(!maybe_classname) {
-			cerr << "[lua] Warn: script does not state a classname at '" << filepath << "'" << endl;
-			cerr << "\tError code is: " << maybe_classname.message() << endl;
-			continue;
+			auto manifest = manifests.find(dirs[i]);
+			if(manifest == manifests.end()) {
+				manifest = manifests.emplace(dirs[i], readClassnameManifest(dirs[i])).first;
+			}
+			const auto listed = manifest->second.find(filenames[i]);
+			if(listed != manifest->second.end()) {
+				maybe_classname = listed->second;
+			}
 		}
+		// Only scripts without classname header or manifest entry have to be run
+		if(!maybe_classname) {
+			maybe_classname = executeForClassname(filepath, filenames[i]);
+		}
+		if(!maybe_classname)
+			continue;
 		const auto classname = maybe_classname.value();
 		if(m_available_devices.find(classname) != m_available_devices.end()) {
 			if(!overwrite_existing) {
@@ -192,12 +395,18 @@ unique_ptr<LuaDevice> LuaFactory::instantiateDevice(const DeviceID& id, const De
 	if(!deviceExists(classname)) {
 		throw (device_not_found_error(classname));
 	}
-	QFile script_file(m_available_devices[classname].c_str());
-	if (!script_file.open(QIODevice::ReadOnly)) {
-		throw(runtime_error("Could not open file " + m_available_devices[classname]));
-	}
-	QByteArray script = script_file.readAll();
+	const std::string& filepath = m_available_devices[classname];
+	const std::string& script = getCompiledScript(filepath);
 
-	return std::make_unique<LuaDevice>(id, loadScriptFromString(L, script.toStdString(), classname), L);
+	lua_State* device_state = createState();
+	{
+		LuaRef env = loadScriptFromString(device_state, script, classname);
+		// Discovery did not run the script, so this is the first time it is checked
+		if(isScriptValidDevice(env, filepath)) {
+			return std::make_unique<LuaDevice>(id, env, device_state);
+		}
+	}	// env must be released before its state is closed
+	LuaAllocator::close(device_state);
+	return nullptr;
 }
 
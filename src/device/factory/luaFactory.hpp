@@ -13,12 +13,52 @@
 #include <string>
 #include <list>
 #include <memory> // unique_ptr
+#include <optional>
+#include <vector>
+
+#include <QByteArray>
+#include <QDateTime>
 
 class LuaFactory {
 	const std::string m_builtin_scripts = ":/devices/lua/";
 	const std::string m_scriptloader = ":/src/device/factory/loadscript.lua";
 
+	struct CompiledScript {
+		QDateTime modified;
+		std::string chunk;	// bytecode, empty if the script did not compile
+	};
+
+	struct DiscoveredScript {
+		bool readable = false;
+		std::optional<std::string> classname;	// if stated in the header
+	};
+
 	std::unordered_map<std::string,std::string> m_available_devices;
+	std::unordered_map<std::string,CompiledScript> m_compiled_scripts;	// by file path
+	QByteArray m_scriptloader_content;
+
+	/**
+	 * @return a new state with the scriptloader loaded, owned by the caller (close with LuaAllocator::close)
+	 */
+	lua_State* createState();
+
+	/**
+	 * Scripts are parsed once per file version, loading the bytecode skips the parser.
+	 * Scripts that already are bytecode (built-in scripts) are taken as they are.
+	 * @return bytecode of the script at filepath, empty if it could not be compiled
+	 */
+	const std::string& getCompiledScript(const std::string& filepath);
+
+	/**
+	 * Reads the classname of the given scripts in parallel, without running them
+	 */
+	static std::vector<DiscoveredScript> discoverScripts(const std::vector<std::string>& files);
+
+	/**
+	 * Fallback for user scripts without classname header: runs the whole script.
+	 * Precompiled built-in scripts are registered from their classname manifest instead.
+	 */
+	std::optional<std::string> executeForClassname(const std::string& filepath, const std::string& filename);
 public:
 
 	LuaFactory();
@@ -27,6 +67,9 @@ public:
 	std::list<DeviceClass> getAvailableDevices();
 
 	bool deviceExists(const DeviceClass& classname);
+	/**
+	 * @return nullptr if the script turns out not to be a valid device
+	 */
 	std::unique_ptr<LuaDevice> instantiateDevice(const DeviceID& id, const DeviceClass& classname);
 };
 
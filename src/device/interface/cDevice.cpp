@@ -13,10 +13,28 @@ Device::Layout CDevice::getLayout() { return m_layout; }
 CDevice::PIN_Interface_C::PIN_Interface_C(CDevice* device) : m_device(device) {}
 CDevice::PIN_Interface_C::~PIN_Interface_C() = default;
 
-Device::PIN_Interface::PinLayout CDevice::PIN_Interface_C::getPinLayout() {
+const Device::PIN_Interface::PinLayout& CDevice::PIN_Interface_C::getPinLayout() {
 	return m_pinLayout;
 }
 
+void CDevice::PIN_Interface_C::indexPins() {
+	m_pin_index.clear();
+	for(const auto& [num, desc] : m_pinLayout) {
+		if(num >= m_pin_index.size()) {
+			m_pin_index.resize(num + 1, nullptr);
+		}
+		m_pin_index[num] = &desc;
+	}
+}
+
+const Device::PIN_Interface::PinDesc* CDevice::PIN_Interface_C::getPinDesc(DevicePin num) {
+	if(num < m_pin_index.size()) {
+		return m_pin_index[num];
+	}
+	// devices without descriptor fill m_pinLayout themselves
+	return m_pin_index.empty() ? PIN_Interface::getPinDesc(num) : nullptr;
+}
+
 void CDevice::PIN_Interface_C::setPin(DevicePin, gpio::Tristate) {
 	std::cerr << "[CDevice] Warning: setPin was not implemented "
 			"for device " << m_device->getClass() << "." << std::endl;
@@ -49,8 +67,58 @@ Config CDevice::Config_Interface_C::getConfig() {
 }
 
 bool CDevice::Config_Interface_C::setConfig(Config conf) {
+	bool ok = true;
+	for(const auto& [name, target] : m_bindings) {
+		auto elem = conf.find(name);
+		if(elem == conf.end()) continue;
+		const ConfigElem& value = elem->second;
+		if(auto b = std::get_if<bool*>(&target); b && value.type == ConfigElem::Type::boolean) {
+			**b = value.value.boolean;
+		} else if(auto i = std::get_if<int64_t*>(&target); i && value.type == ConfigElem::Type::integer) {
+			**i = value.value.integer;
+		} else if(auto s = std::get_if<std::string*>(&target); s && value.type == ConfigElem::Type::string) {
+			**s = value.value.string;
+		} else {
+			std::cerr << "[CDevice] Config value '" << name << "' of device "
+					<< m_device->getClass() << " has the wrong type." << std::endl;
+			ok = false;
+		}
+	}
 	m_config = conf;
-	return true;
+	// bound parameters are always part of the config, with their current value
+	for(const auto& [name, target] : m_bindings) {
+		store(name, target);
+	}
+	return ok;
+}
+
+void CDevice::Config_Interface_C::store(const ConfigDescription& name, const Target& target) {
+	m_config.erase(name);
+	if(auto b = std::get_if<bool*>(&target)) {
+		m_config.emplace(name, ConfigElem(**b));
+	} else if(auto i = std::get_if<int64_t*>(&target)) {
+		m_config.emplace(name, ConfigElem(**i));
+	} else if(auto s = std::get_if<std::string*>(&target)) {
+		m_config.emplace(name, ConfigElem((*s)->c_str()));
+	}
+}
+
+void CDevice::Config_Interface_C::bind(const ConfigDescription& name, bool& target, bool default_value) {
+	target = default_value;
+	m_bindings[name] = &target;
+	store(name, &target);
+}
+
+void CDevice::Config_Interface_C::bind(const ConfigDescription& name, int64_t& target, int64_t default_value) {
+	target = default_value;
+	m_bindings[name] = &target;
+	store(name, &target);
+}
+
+void CDevice::Config_Interface_C::bind(const ConfigDescription& name, std::string& target, const std::string& default_value) {
+	target = default_value;
+	m_bindings[name] = &target;
+	store(name, &target);
 }
 
 /* Input interface */
@@ -2,18 +2,69 @@
 
 #include <device.hpp>
 
+#include <array>
+#include <variant>
+
 class CDevice : public Device {
 protected:
 	Layout m_layout;
 public:
+	struct PinDescriptor {
+		PIN_Interface::DevicePin number;
+		PIN_Interface::Dir dir;
+		const char* name;
+		DeviceRow row;
+		DeviceIndex index;
+	};
+
+	/**
+	 * Static description of a device class as `static constexpr Descriptor<N> descriptor`,
+	 * checked at compile time by CFactory::registerDeviceType.
+	 */
+	template<size_t num_pins>
+	struct Descriptor {
+		unsigned width;		// as raster rows
+		unsigned height;	// as raster indexes
+		std::array<PinDescriptor,num_pins> pins;
+		const char* data_type = "rgba";	// see Layout
+
+		/**
+		 * @return true if pin numbers are unique and all pins lie on the device
+		 */
+		constexpr bool isValid() const {
+			for(size_t i = 0; i < num_pins; i++) {
+				if(pins[i].row >= width || pins[i].index >= height) return false;
+				for(size_t j = i + 1; j < num_pins; j++) {
+					if(pins[i].number == pins[j].number) return false;
+				}
+			}
+			return true;
+		}
+
+		Layout getLayout() const {
+			return Layout{width, height, data_type};
+		}
+	};
+
 	class PIN_Interface_C : public Device::PIN_Interface {
+		std::vector<const PinDesc*> m_pin_index;	// by pin number, into m_pinLayout
+
+		void indexPins();
 	protected:
 		CDevice* m_device;
 		PinLayout m_pinLayout;
 	public:
 		PIN_Interface_C(CDevice* device);
+		template<size_t num_pins>
+		PIN_Interface_C(CDevice* device, const std::array<PinDescriptor,num_pins>& pins) : m_device(device) {
+			for(const PinDescriptor& pin : pins) {
+				m_pinLayout.emplace(pin.number, PinDesc{pin.dir, pin.name, pin.row, pin.index});
+			}
+			indexPins();
+		}
 		~PIN_Interface_C();
-		PinLayout getPinLayout() override;
+		const PinLayout& getPinLayout() override;
+		const PinDesc* getPinDesc(DevicePin num) override;
 		gpio::Tristate getPin(DevicePin num) override; // implement this
 		void setPin(DevicePin num, gpio::Tristate val) override;	// implement this
 	};
@@ -28,6 +79,10 @@ public:
 	};
 
 	class Config_Interface_C : public Device::Config_Interface {
+		typedef std::variant<bool*,int64_t*,std::string*> Target;
+		std::unordered_map<ConfigDescription,Target> m_bindings;
+
+		void store(const ConfigDescription& name, const Target& target);
 	protected:
 		CDevice* m_device;
 		Config m_config;
@@ -36,6 +91,15 @@ public:
 		~Config_Interface_C();
 		Config getConfig() override;
 		bool setConfig(Config conf) override;
+
+		/**
+		 * Declares a parameter that is read into target on every setConfig,
+		 * so the device can use target without looking into the Config.
+		 * target is set to default_value right away and has to outlive this interface.
+		 */
+		void bind(const ConfigDescription& name, bool& target, bool default_value);
+		void bind(const ConfigDescription& name, int64_t& target, int64_t default_value);
+		void bind(const ConfigDescription& name, std::string& target, const std::string& default_value);
 	};
 
 	class Input_Interface_C : public Device::Input_Interface {
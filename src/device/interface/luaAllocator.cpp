@@ -0,0 +1,164 @@
+/*
+ * luaAllocator.cpp
+ *
+ * Allocator for the Lua state of a single device
+ */
+#include "luaAllocator.hpp"
+
+extern "C"
+{
+#if defined(USE_LUAJIT)
+	#include <lua.h>
+	#include <lauxlib.h>
+#elif __has_include(<lua5.3/lua.h>)
+	#include <lua5.3/lua.h>
+	#include <lua5.3/lauxlib.h>
+#elif  __has_include(<lua.h>)
+	#include <lua.h>
+	#include <lauxlib.h>
+#else
+	#error("No lua libraries found")
+#endif
+}
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using std::cerr;
+using std::endl;
+
+LuaAllocator::~LuaAllocator() {
+	// blocks bigger than max_pooled were all released by lua_close
+	for(void* chunk : m_chunks) {
+		free(chunk);
+	}
+}
+
+size_t LuaAllocator::sizeClass(size_t size) {
+	return (size + granularity - 1) / granularity - 1;
+}
+
+void* LuaAllocator::allocate(size_t size) {
+	void* block;
+	if(size > max_pooled) {
+		block = malloc(size);
+		if(!block) return nullptr;
+	}
+	else {
+		const size_t cls = sizeClass(size);
+		if(m_free[cls]) {
+			block = m_free[cls];
+			m_free[cls] = m_free[cls]->next;
+		}
+		else {
+			const size_t block_size = (cls + 1) * granularity;
+			if(m_chunk_end - m_chunk_pos < static_cast<ptrdiff_t>(block_size)) {
+				char* chunk = static_cast<char*>(malloc(chunk_size));
+				if(!chunk) return nullptr;
+				m_chunks.push_back(chunk);
+				m_chunk_pos = chunk;
+				m_chunk_end = chunk + chunk_size;
+			}
+			block = m_chunk_pos;
+			m_chunk_pos += block_size;
+		}
+	}
+	m_used += size;
+	if(m_used > m_peak) m_peak = m_used;
+	return block;
+}
+
+void LuaAllocator::release(void* block, size_t size) {
+	if(size > max_pooled) {
+		free(block);
+	}
+	else {
+		const size_t cls = sizeClass(size);
+		FreeBlock* free_block = static_cast<FreeBlock*>(block);
+		free_block->next = m_free[cls];
+		m_free[cls] = free_block;
+	}
+	m_used -= size;
+}
+
+void* LuaAllocator::reallocate(void* block, size_t old_size, size_t new_size) {
+	if(new_size == 0) {
+		if(block) release(block, old_size);
+		return nullptr;
+	}
+	// Lua expects shrinking to succeed, so only growing is limited
+	if(m_limit && new_size > old_size && m_used - old_size + new_size > m_limit) {
+		return nullptr;
+	}
+	if(!block) {
+		return allocate(new_size);
+	}
+	if(old_size > max_pooled && new_size > max_pooled) {
+		void* moved = realloc(block, new_size);
+		if(!moved) return nullptr;
+		m_used = m_used - old_size + new_size;
+		if(m_used > m_peak) m_peak = m_used;
+		return moved;
+	}
+	if(old_size <= max_pooled && new_size <= max_pooled && sizeClass(old_size) == sizeClass(new_size)) {
+		m_used = m_used - old_size + new_size;
+		if(m_used > m_peak) m_peak = m_used;
+		return block;
+	}
+	void* moved = allocate(new_size);
+	if(!moved) return nullptr;
+	memcpy(moved, block, old_size < new_size ? old_size : new_size);
+	release(block, old_size);
+	return moved;
+}
+
+void* LuaAllocator::alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+	// without a block, osize only tells the type of the new object
+	return static_cast<LuaAllocator*>(ud)->reallocate(ptr, ptr ? osize : 0, nsize);
+}
+
+static int panic(lua_State* L) {
+	const char* msg = lua_tostring(L, -1);
+	cerr << "[lua] PANIC: unprotected error in call to Lua API (" << (msg ? msg : "error object is not a string") << ")" << endl;
+	return 0;	// abort
+}
+
+lua_State* LuaAllocator::newState() {
+	LuaAllocator* allocator = new LuaAllocator();
+	lua_State* L = lua_newstate(&alloc, allocator);
+	if(!L) {
+		delete allocator;
+		return luaL_newstate();
+	}
+	lua_atpanic(L, &panic);
+	return L;
+}
+
+void LuaAllocator::close(lua_State* L) {
+	LuaAllocator* allocator = of(L);
+	lua_close(L);
+	delete allocator;
+}
+
+LuaAllocator* LuaAllocator::of(lua_State* L) {
+	void* ud;
+	if(lua_getallocf(L, &ud) != &alloc) return nullptr;
+	return static_cast<LuaAllocator*>(ud);
+}
+
+void LuaAllocator::setLimit(size_t bytes) {
+	m_limit = bytes;
+}
+
+size_t LuaAllocator::getLimit() const {
+	return m_limit;
+}
+
+size_t LuaAllocator::getUsed() const {
+	return m_used;
+}
+
+size_t LuaAllocator::getPeak() const {
+	return m_peak;
+}
@@ -0,0 +1,74 @@
+/*
+ * luaAllocator.hpp
+ *
+ * Allocator for the Lua state of a single device
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+struct lua_State;
+
+/**
+ * Small blocks are served from per size class free lists carved out of larger
+ * chunks, bigger ones come from malloc. Every state gets its own allocator, so
+ * the memory of a device can be accounted for and limited. Not thread safe,
+ * the state is only used under the device's lock anyway.
+ */
+class LuaAllocator {
+	static constexpr size_t granularity = 16;
+	static constexpr size_t max_pooled = 256;				// bytes, bigger blocks are not pooled
+	static constexpr size_t num_classes = max_pooled / granularity;
+	static constexpr size_t chunk_size = 64 * 1024;
+
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	std::array<FreeBlock*,num_classes> m_free = {};
+	std::vector<void*> m_chunks;
+	char* m_chunk_pos = nullptr;	// unused rest of the newest chunk
+	char* m_chunk_end = nullptr;
+
+	size_t m_used = 0;
+	size_t m_peak = 0;
+	size_t m_limit = 0;				// zero is unlimited
+
+	static size_t sizeClass(size_t size);
+	void* allocate(size_t size);
+	void release(void* block, size_t size);
+	void* reallocate(void* block, size_t old_size, size_t new_size);
+
+	static void* alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+	LuaAllocator() = default;
+	~LuaAllocator();
+
+public:
+	LuaAllocator(const LuaAllocator&) = delete;
+	LuaAllocator& operator=(const LuaAllocator&) = delete;
+
+	/**
+	 * @return a new state using its own allocator, or one with the default allocator
+	 * if the Lua implementation does not allow custom allocators (e.g. LuaJIT on x64).
+	 * Has to be closed with close().
+	 */
+	static lua_State* newState();
+	static void close(lua_State* L);
+	/**
+	 * @return nullptr if the state does not use a LuaAllocator
+	 */
+	static LuaAllocator* of(lua_State* L);
+
+	/**
+	 * Allocations that would exceed the limit fail after an emergency collection,
+	 * which raises a memory error in the script. Zero removes the limit.
+	 */
+	void setLimit(size_t bytes);
+	size_t getLimit() const;
+	size_t getUsed() const;
+	size_t getPeak() const;
+};
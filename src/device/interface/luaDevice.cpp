@@ -5,9 +5,17 @@
  *      Author: dwd
  */
 #include "luaDevice.hpp"
+#include "luaAllocator.hpp"
 
 #include <QKeySequence>
 
+#include <algorithm>
+#include <cmath>
+#include <new>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
 using std::string;
 using std::cout;
 using std::cerr;
@@ -15,19 +23,39 @@ using std::endl;
 using luabridge::LuaRef;
 using luabridge::LuaResult;
 
+/* Default for scripts not declaring memory_limit_kb */
+const size_t default_memory_limit_kb = 32 * 1024;
+
+LuaDevice::LuaDevice(const DeviceID& id, LuaRef env, lua_State* l) : Device(id),
+		m_state(l, &LuaAllocator::close), m_env(env),
+		// If Device exists, classname is known to exist of correct type
+		m_classname(m_env["classname"].unsafe_cast<string>()), L(l), m_watchdog(Watchdog::of(l)) {
+	const auto budget = m_env["cpu_budget_ms"].cast<unsigned>();
+	if(budget) {
+		m_watchdog.setBudget(std::chrono::milliseconds(budget.value()));
+	}
+	configureMemory();
 
-LuaDevice::LuaDevice(const DeviceID& id, LuaRef env, lua_State* l) : Device(id), m_env(env), L(l){
 	if(PIN_Interface_Lua::implementsInterface(m_env)) {
-		m_pin = std::make_unique<PIN_Interface_Lua>(m_env);
+		auto pin = std::make_unique<PIN_Interface_Lua>(m_env, m_watchdog);
+		pin->getPinLayout();	// read the layout while placing the device, not on its first connection
+		std::function<void()> invalidate = [pin = pin.get()]() {
+			pin->invalidatePinLayout();
+		};
+		registerGlobalFunctionAndInsertLocalAlias<>("invalidatePinLayout", invalidate);
+		m_pin = std::move(pin);
 	}
 	if(SPI_Interface_Lua::implementsInterface(m_env)) {
-		m_spi = std::make_unique<SPI_Interface_Lua>(m_env);
+		m_spi = std::make_unique<SPI_Interface_Lua>(m_env, m_watchdog);
 	}
 	if(Config_Interface_Lua::implementsInterface(m_env)) {
-		m_conf = std::make_unique<Config_Interface_Lua>(m_env);
+		m_conf = std::make_unique<Config_Interface_Lua>(m_env, m_watchdog);
 	}
 	if(Input_Interface_Lua::implementsInterface(m_env)) {
-		m_input = std::make_unique<Input_Interface_Lua>(m_env);
+		m_input = std::make_unique<Input_Interface_Lua>(m_env, m_watchdog);
+	}
+	if(Timer_Interface_Lua::implementsInterface(L)) {
+		m_timer = std::make_unique<Timer_Interface_Lua>(this, L, m_watchdog);
 	}
 
 	if(implementsGraphFunctions()) {
@@ -35,11 +63,48 @@ LuaDevice::LuaDevice(const DeviceID& id, LuaRef env, lua_State* l) : Device(id),
 	}
 };
 
-LuaDevice::~LuaDevice() = default;
+LuaDevice::~LuaDevice() {
+	// The interfaces hold references into the state and are owned by the base class
+	m_pin.reset();
+	m_spi.reset();
+	m_conf.reset();
+	m_input.reset();
+	m_timer.reset();
+}
 
 const DeviceClass LuaDevice::getClass() const {
-	// If Device exists, classname is known to exist of correct type
-	return m_env["classname"].unsafe_cast<string>();
+	return m_classname;
+}
+
+string LuaDevice::getStatistics() {
+	const Watchdog::Statistics& stats = m_watchdog.getStatistics();
+	std::ostringstream out;
+	out << "Lua: " << stats.calls << " calls, "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(stats.time).count() << " ms";
+	if(stats.aborted) {
+		out << ", " << stats.aborted << " over budget";
+	}
+	if(const LuaAllocator* allocator = LuaAllocator::of(L)) {
+		out << ", " << allocator->getUsed() / 1024 << " KiB (peak " << allocator->getPeak() / 1024 << " KiB)";
+	}
+	return out.str();
+}
+
+void LuaDevice::configureMemory() {
+	if(LuaAllocator* allocator = LuaAllocator::of(L)) {
+		const auto limit_kb = m_env["memory_limit_kb"].cast<unsigned>();
+		allocator->setLimit((limit_kb ? limit_kb.value() : default_memory_limit_kb) * 1024);
+	}
+
+	// incremental collector, as percentages (see lua_gc)
+	const auto pause = m_env["gc_pause"].cast<int>();
+	if(pause) {
+		lua_gc(L, LUA_GCSETPAUSE, pause.value());
+	}
+	const auto stepmul = m_env["gc_stepmul"].cast<int>();
+	if(stepmul) {
+		lua_gc(L, LUA_GCSETSTEPMUL, stepmul.value());
+	}
 }
 
 bool LuaDevice::implementsGraphFunctions() {
@@ -47,6 +112,7 @@ bool LuaDevice::implementsGraphFunctions() {
 		//cout << "getGraphBufferLayout not a Function" << endl;
 		return false;
 	}
+	Watchdog::Call call(m_watchdog);
 	LuaResult r = m_env["getGraphBufferLayout"]();
 	if(r.size() != 1 || !r[0].isTable() || r[0].length() != 3) {
 		//cout << "return val is " << r.size() << " " << !r[0].isTable() << r[0].length() << endl;
@@ -65,6 +131,7 @@ Device::Layout LuaDevice::getLayout() {
 		return Device::getLayout();
 	}
 	Layout ret;
+	Watchdog::Call call(m_watchdog);
 	LuaResult r = m_getGraphBufferLayout();
 	if(!r || r.size() != 1 || !r[0].isTable() || r[0].length() != 3) {
 		cerr << "[LuaDevice] Graph Layout malformed " << r.errorMessage() << endl;
@@ -79,8 +146,8 @@ Device::Layout LuaDevice::getLayout() {
 	ret.width = maybe_width.value();
 	ret.height = maybe_height.value();
 	const auto& type = r[0][3];
-	if(!type.isString() || type != string("rgba")) {
-		cerr << "[LuaDevice] Graph Layout type may only be 'rgba' at the moment." << endl;
+	if(!type.isString()) {
+		cerr << "[LuaDevice] Graph Layout type has to be 'rgba', 'rgb565', 'mono' or 'palette8'." << endl;
 		return ret;
 	}
 	ret.data_type = type.unsafe_cast<string>();
@@ -89,6 +156,7 @@ Device::Layout LuaDevice::getLayout() {
 
 void LuaDevice::initializeBuffer(){
 	if(m_initializeGraphBuffer.isFunction()) {
+		Watchdog::Call call(m_watchdog);
 		m_initializeGraphBuffer();
 	} else {
 		//cout << "Device " << m_deviceId << " does not implement 'initializeGraphBuffer()'" << endl;
@@ -108,6 +176,10 @@ void LuaDevice::declarePixelFormat(lua_State* L) {
 				.addProperty ("b", &Pixel::b)
 				.addProperty ("a", &Pixel::a)
 			  .endClass ()
+			  // packed pixels for the bulk functions, 0xRRGGBBAA
+			  .addFunction ("rgba", +[](const uint8_t r, const uint8_t g, const uint8_t b, const uint8_t a) -> PackedPixel {
+				  return (PackedPixel)r << 24 | (PackedPixel)g << 16 | (PackedPixel)b << 8 | a;
+			  })
 			.endNamespace()
 		;
 		//cout << "Graphbuf: Declared Pixel class to lua." << endl;
@@ -152,14 +224,80 @@ void LuaDevice::createBuffer(unsigned iconSizeMinimum, QPoint offset) {
 	};
 
 	registerGlobalFunctionAndInsertLocalAlias<>("setGraphbuffer", setBuf);
+
+	// Bulk functions, taking packed pixels from graphbuf.rgba(r, g, b, a)
+	std::function<void(const Xoffset, const Yoffset, unsigned, unsigned, PackedPixel)> fillBuf =
+			[this](const Xoffset x, const Yoffset y, unsigned width, unsigned height, PackedPixel p) {
+		fillRect(x, y, width, height, unpack(p));
+	};
+	registerGlobalFunctionAndInsertLocalAlias<>("fillGraphbuffer", fillBuf);
+	// row is either a string of rgba bytes or a table of packed pixels
+	std::function<void(const Xoffset, const Yoffset, LuaRef)> setRow = [this](const Xoffset x, const Yoffset y, LuaRef row) {
+		if(row.isString()) {
+			size_t len;
+			row.push(L);
+			const char* bytes = lua_tolstring(L, -1, &len);
+			lua_pop(L, 1);
+			blit(x, y, len/4, 1, reinterpret_cast<const uint8_t*>(bytes));
+		}
+		else if(row.isTable()) {
+			const int len = row.length();
+			std::vector<uint8_t> bytes(len*4);
+			for(int i = 0; i < len; i++) {
+				const Pixel p = unpack(row[i+1].unsafe_cast<PackedPixel>());
+				bytes[i*4+0] = p.r;
+				bytes[i*4+1] = p.g;
+				bytes[i*4+2] = p.b;
+				bytes[i*4+3] = p.a;
+			}
+			blit(x, y, len, 1, bytes.data());
+		}
+		else {
+			cerr << "[LuaDevice] setGraphbufferRow expects a string or a table" << endl;
+		}
+	};
+	registerGlobalFunctionAndInsertLocalAlias<>("setGraphbufferRow", setRow);
+	std::function<void(const Xoffset, const Yoffset, unsigned, unsigned, LuaRef)> blitBuf =
+			[this](const Xoffset x, const Yoffset y, unsigned width, unsigned height, LuaRef data) {
+		if(!data.isString()) {
+			cerr << "[LuaDevice] blitGraphbuffer expects a string of rgba bytes" << endl;
+			return;
+		}
+		size_t len;
+		data.push(L);
+		const char* bytes = lua_tolstring(L, -1, &len);
+		lua_pop(L, 1);
+		if(len < (size_t)width * height * 4) {
+			cerr << "[LuaDevice] blitGraphbuffer data too short for " << width << "x" << height << endl;
+			return;
+		}
+		blit(x, y, width, height, reinterpret_cast<const uint8_t*>(bytes));
+	};
+	registerGlobalFunctionAndInsertLocalAlias<>("blitGraphbuffer", blitBuf);
+	std::function<void(const Xoffset, const Yoffset, uint32_t, unsigned, PackedPixel, PackedPixel)> setColumn =
+			[this](const Xoffset x, const Yoffset y, uint32_t bits, unsigned count, PackedPixel on, PackedPixel off) {
+		setColumnBits(x, y, bits, count, unpack(on), unpack(off));
+	};
+	registerGlobalFunctionAndInsertLocalAlias<>("setGraphbufferColumnBits", setColumn);
+	// colour's alpha is scaled by a cached radial mask
+	std::function<void(PackedPixel)> fillGlow = [this](PackedPixel colour) {
+		Device::fillGlow(unpack(colour));
+	};
+	registerGlobalFunctionAndInsertLocalAlias<>("fillGraphbufferGlow", fillGlow);
+	// for 'mono' and 'palette8' buffers
+	std::function<void(unsigned, PackedPixel)> setPalette = [this](unsigned index, PackedPixel colour) {
+		setPaletteEntry(index, unpack(colour));
+	};
+	registerGlobalFunctionAndInsertLocalAlias<>("setGraphbufferPalette", setPalette);
+
 	m_env["buffer_width"] = m_buffer.width();
 	m_env["buffer_height"] = m_buffer.height();
 	initializeBuffer();
 }
 
-LuaDevice::PIN_Interface_Lua::PIN_Interface_Lua(LuaRef& ref) :
+LuaDevice::PIN_Interface_Lua::PIN_Interface_Lua(LuaRef& ref, Watchdog& watchdog) :
 		m_getPinLayout(ref["getPinLayout"]),
-		m_getPin(ref["getPin"]), m_setPin(ref["setPin"]) {
+		m_getPin(ref["getPin"]), m_setPin(ref["setPin"]), m_watchdog(watchdog) {
 	if(!implementsInterface(ref)) {
 		cerr << "[LuaDevice] WARN: Device " << ref << " not implementing interface" << endl;
 	}
@@ -174,8 +312,21 @@ bool LuaDevice::PIN_Interface_Lua::implementsInterface(const luabridge::LuaRef&
 			ref["setPin"].isFunction());
 }
 
-Device::PIN_Interface::PinLayout LuaDevice::PIN_Interface_Lua::getPinLayout() {
+const Device::PIN_Interface::PinLayout& LuaDevice::PIN_Interface_Lua::getPinLayout() {
+	if(!m_layout_valid) {
+		m_layout = readPinLayout();
+		m_layout_valid = true;
+	}
+	return m_layout;
+}
+
+void LuaDevice::PIN_Interface_Lua::invalidatePinLayout() {
+	m_layout_valid = false;
+}
+
+Device::PIN_Interface::PinLayout LuaDevice::PIN_Interface_Lua::readPinLayout() {
 	PinLayout ret;
+	Watchdog::Call call(m_watchdog);
 	LuaResult r = m_getPinLayout();
 	//cout << r.size() << " elements in pinlayout" << endl;
 
@@ -238,12 +389,38 @@ Device::PIN_Interface::PinLayout LuaDevice::PIN_Interface_Lua::getPinLayout() {
 }
 
 
+void LuaDevice::PIN_Interface_Lua::declarePinStates(lua_State* L) {
+	lua_createtable(L, 0, 3);
+	lua_pushinteger(L, LOW);
+	lua_setfield(L, -2, "LOW");
+	lua_pushinteger(L, HIGH);
+	lua_setfield(L, -2, "HIGH");
+	lua_pushinteger(L, UNSET);
+	lua_setfield(L, -2, "UNSET");
+	lua_setglobal(L, "gpio");
+}
+
 gpio::Tristate LuaDevice::PIN_Interface_Lua::getPin(DevicePin num) {
+	Watchdog::Call call(m_watchdog);
 	const LuaResult r = m_getPin(num);
-	if(!r || !r[0].isString()) {
+	if(!r || r.size() < 1) {
 		cerr << "[LuaDevice] Device getPin returned malformed output: " << r.errorMessage() << endl;
 		return gpio::Tristate::UNSET;
 	}
+	if(r[0].isNumber()) {
+		switch(r[0].unsafe_cast<lua_Integer>()) {
+		case LOW: return gpio::Tristate::LOW;
+		case HIGH: return gpio::Tristate::HIGH;
+		case UNSET: return gpio::Tristate::UNSET;
+		}
+		cerr << "[LuaDevice] Warn: getPin returned invalid state " << r[0] << endl;
+		return gpio::Tristate::UNSET;
+	}
+	// Strings are still accepted for older scripts
+	if(!r[0].isString()) {
+		cerr << "[LuaDevice] Device getPin returned malformed output: " << r[0] << endl;
+		return gpio::Tristate::UNSET;
+	}
 	string pin_enum = r[0].tostring();
 	if(pin_enum == "LOW") return gpio::Tristate::LOW;
 	if(pin_enum == "HIGH") return gpio::Tristate::HIGH;
@@ -253,14 +430,19 @@ gpio::Tristate LuaDevice::PIN_Interface_Lua::getPin(DevicePin num) {
 }
 
 void LuaDevice::PIN_Interface_Lua::setPin(DevicePin num, gpio::Tristate val) {
-	const LuaResult r = m_setPin(num, val == gpio::Tristate::HIGH ? true : false);
+	State state = UNSET;
+	if(val == gpio::Tristate::LOW) state = LOW;
+	else if(val == gpio::Tristate::HIGH) state = HIGH;
+	// The boolean is kept as second argument for older scripts
+	Watchdog::Call call(m_watchdog);
+	const LuaResult r = m_setPin(num, val == gpio::Tristate::HIGH, static_cast<lua_Integer>(state));
 	if(!r) {
 		cerr << "[LuaDevice] Device setPin error: " << r.errorMessage() << endl;
 	}
 }
 
-LuaDevice::SPI_Interface_Lua::SPI_Interface_Lua(LuaRef& ref) :
-		m_send(ref["receiveSPI"]) {
+LuaDevice::SPI_Interface_Lua::SPI_Interface_Lua(LuaRef& ref, Watchdog& watchdog) :
+		m_send(ref["receiveSPI"]), m_sendBurst(ref["receiveSPIBurst"]), m_watchdog(watchdog) {
 	if(!implementsInterface(ref))
 		cerr << "[LuaDevice] " << ref << " not implementing SPI interface" << endl;
 }
@@ -269,6 +451,7 @@ LuaDevice::SPI_Interface_Lua::~SPI_Interface_Lua() = default;
 
 
 gpio::SPI_Response LuaDevice::SPI_Interface_Lua::send(gpio::SPI_Command byte) {
+	Watchdog::Call call(m_watchdog);
 	LuaResult r = m_send(byte);
 	if(r.size() != 1) {
 		cerr << "[LuaDevice] send SPI function failed! " << r.errorMessage() << endl;
@@ -281,12 +464,33 @@ gpio::SPI_Response LuaDevice::SPI_Interface_Lua::send(gpio::SPI_Command byte) {
 	return r[0];
 }
 
+void LuaDevice::SPI_Interface_Lua::sendBurst(const gpio::SPI_Command* bytes, size_t count, gpio::SPI_Response* responses) {
+	if(!m_sendBurst.isFunction()) {
+		SPI_Interface::sendBurst(bytes, count, responses);
+		return;
+	}
+	static_assert(sizeof(gpio::SPI_Command) == 1 && sizeof(gpio::SPI_Response) == 1, "SPI bursts are passed as strings");
+	Watchdog::Call call(m_watchdog);
+	LuaResult r = m_sendBurst(string(reinterpret_cast<const char*>(bytes), count));
+	if(!r.wasOk()) {
+		cerr << "[LuaDevice] SPI burst function failed! " << r.errorMessage() << endl;
+	}
+	if(!responses) return;
+	memset(responses, 0, count);
+	if(r.size() >= 1 && r[0].isString()) {
+		const auto returned = r[0].cast<string>();
+		if(returned) {
+			memcpy(responses, returned.value().data(), std::min(count, returned.value().size()));
+		}
+	}
+}
+
 bool LuaDevice::SPI_Interface_Lua::implementsInterface(const LuaRef& ref) {
 	return ref["receiveSPI"].isFunction();
 }
 
-LuaDevice::Config_Interface_Lua::Config_Interface_Lua(luabridge::LuaRef& ref) :
-	m_getConf(ref["getConfig"]), m_setConf(ref["setConfig"]), m_env(ref){
+LuaDevice::Config_Interface_Lua::Config_Interface_Lua(luabridge::LuaRef& ref, Watchdog& watchdog) :
+	m_getConf(ref["getConfig"]), m_setConf(ref["setConfig"]), m_env(ref), m_watchdog(watchdog){
 
 };
 
@@ -298,6 +502,7 @@ bool LuaDevice::Config_Interface_Lua::implementsInterface(const luabridge::LuaRe
 
 Config LuaDevice::Config_Interface_Lua::getConfig(){
 	Config ret;
+	Watchdog::Call call(m_watchdog);
 	LuaResult r = m_getConf();
 
 	// TODO: Check success and print result
@@ -363,6 +568,7 @@ bool LuaDevice::Config_Interface_Lua::setConfig(Config conf) {
 		}
 	}
 
+	Watchdog::Call call(m_watchdog);
 	LuaResult r = m_setConf(c);
 	if(!r) {
 		std::cerr << "[LuaDevice] Error setting config of [some] device: : " << r.errorMessage() << std::endl;
@@ -370,8 +576,8 @@ bool LuaDevice::Config_Interface_Lua::setConfig(Config conf) {
 	return r.wasOk();
 }
 
-LuaDevice::Input_Interface_Lua::Input_Interface_Lua(luabridge::LuaRef& ref) : m_onClick(ref["onClick"]),
-		m_onKeypress(ref["onKeypress"]), m_env(ref) {
+LuaDevice::Input_Interface_Lua::Input_Interface_Lua(luabridge::LuaRef& ref, Watchdog& watchdog) : m_onClick(ref["onClick"]),
+		m_onKeypress(ref["onKeypress"]), m_env(ref), m_watchdog(watchdog) {
 	if(!implementsInterface(ref))
 		cerr << "[LuaDevice] WARN: Device " << ref << " not implementing interface" << endl;
 }
@@ -379,14 +585,134 @@ LuaDevice::Input_Interface_Lua::Input_Interface_Lua(luabridge::LuaRef& ref) : m_
 LuaDevice::Input_Interface_Lua::~Input_Interface_Lua() = default;
 
 void LuaDevice::Input_Interface_Lua::onClick(bool active) {
-	m_onClick(active);
+	if(!m_onClick.isFunction()) return;
+	Watchdog::Call call(m_watchdog);
+	const LuaResult r = m_onClick(active);
+	if(!r) {
+		cerr << "[LuaDevice] Device onClick error: " << r.errorMessage() << endl;
+	}
 }
 
 void LuaDevice::Input_Interface_Lua::onKeypress(Key key, bool active) {
-	m_onKeypress(QKeySequence(key).toString().toStdString(), active);
+	if(!m_onKeypress.isFunction()) return;
+	Watchdog::Call call(m_watchdog);
+	const LuaResult r = m_onKeypress(QKeySequence(key).toString().toStdString(), active);
+	if(!r) {
+		cerr << "[LuaDevice] Device onKeypress error: " << r.errorMessage() << endl;
+	}
 }
 
 bool LuaDevice::Input_Interface_Lua::implementsInterface(const luabridge::LuaRef& ref) {
 	return !ref["onClick"].isNil() || !ref["onKeypress"].isNil();
 }
 
+
+static double toMilliseconds(Device::Timer_Interface::Time time) {
+	return time.count() / 1000.;
+}
+
+static Device::Timer_Interface::Time fromMilliseconds(double ms) {
+	return Device::Timer_Interface::Time(std::llround(ms * 1000));
+}
+
+LuaDevice::Timer_Interface_Lua::Timer_Interface_Lua(Device* device, lua_State* L, Watchdog& watchdog) :
+		Timer_Interface(device), m_runDueTasks(luabridge::getGlobal(L, "_run_due_tasks")), m_watchdog(watchdog) {
+	std::function<void(double)> requestWakeup = [this](double ms) {
+		wakeAt(fromMilliseconds(ms));
+	};
+	luabridge::getGlobalNamespace(L)
+		.addFunction("_request_wakeup", requestWakeup)
+	;
+	// tasks spawned while the script was loaded
+	Watchdog::Call call(m_watchdog);
+	LuaResult next = luabridge::getGlobal(L, "_next_task_wakeup")();
+	if(next.wasOk() && next.size() == 1 && next[0].isNumber()) {
+		wakeAt(fromMilliseconds(next[0].unsafe_cast<double>()));
+	}
+}
+
+LuaDevice::Timer_Interface_Lua::~Timer_Interface_Lua() = default;
+
+void LuaDevice::Timer_Interface_Lua::onWakeup(Time now) {
+	Watchdog::Call call(m_watchdog);
+	LuaResult r = m_runDueTasks(toMilliseconds(now));
+	if(!r.wasOk()) {
+		cerr << "[LuaDevice] Running timed tasks failed: " << r.errorMessage() << endl;
+	}
+}
+
+void LuaDevice::Timer_Interface_Lua::declareSimulationTime(lua_State* L) {
+	luabridge::getGlobalNamespace(L)
+		.addFunction("simulation_time", +[]() {
+			return toMilliseconds(Timer_Interface::now());
+		})
+	;
+}
+
+bool LuaDevice::Timer_Interface_Lua::implementsInterface(lua_State* L) {
+	// loadscript.lua defines the task functions for every script, only spawn creates tasks
+	LuaRef hasTasks = luabridge::getGlobal(L, "_has_tasks");
+	if(!hasTasks.isFunction()) {
+		return false;
+	}
+	LuaResult r = hasTasks();
+	return r.wasOk() && r.size() == 1 && r[0].isBool() && r[0].unsafe_cast<bool>();
+}
+
+/* Watchdog */
+
+static char watchdog_key;	// address identifies the watchdog in the registry
+
+static_assert(std::is_trivially_destructible_v<LuaDevice::Watchdog>, "Watchdog userdata is freed without __gc");
+
+LuaDevice::Watchdog& LuaDevice::Watchdog::install(lua_State* L) {
+	lua_pushlightuserdata(L, &watchdog_key);
+	auto* watchdog = new (lua_newuserdata(L, sizeof(Watchdog))) Watchdog();
+	lua_rawset(L, LUA_REGISTRYINDEX);
+	// always set, the budget is checked by the hook, as coroutines keep the hook they were created with
+	lua_sethook(L, &hook, LUA_MASKCOUNT, hook_interval);
+	return *watchdog;
+}
+
+LuaDevice::Watchdog& LuaDevice::Watchdog::of(lua_State* L) {
+	lua_pushlightuserdata(L, &watchdog_key);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	auto* watchdog = static_cast<Watchdog*>(lua_touserdata(L, -1));
+	lua_pop(L, 1);
+	return watchdog ? *watchdog : install(L);
+}
+
+void LuaDevice::Watchdog::setBudget(std::chrono::milliseconds budget) {
+	m_budget = budget;
+}
+
+const LuaDevice::Watchdog::Statistics& LuaDevice::Watchdog::getStatistics() const {
+	return m_stats;
+}
+
+void LuaDevice::Watchdog::hook(lua_State* L, lua_Debug*) {
+	lua_pushlightuserdata(L, &watchdog_key);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	auto* watchdog = static_cast<Watchdog*>(lua_touserdata(L, -1));
+	lua_pop(L, 1);
+	// every entry from C++, including loading the script, is wrapped in a Call
+	if(!watchdog || !watchdog->m_depth || watchdog->m_budget <= std::chrono::milliseconds::zero()) return;
+	if(Clock::now() - watchdog->m_start < watchdog->m_budget) return;
+	if(!watchdog->m_aborted) {
+		watchdog->m_aborted = true;
+		watchdog->m_stats.aborted++;
+	}
+	luaL_error(L, "exceeded CPU budget of %d ms", static_cast<int>(watchdog->m_budget.count()));
+}
+
+LuaDevice::Watchdog::Call::Call(Watchdog& watchdog) : m_watchdog(watchdog) {
+	if(m_watchdog.m_depth++) return;
+	m_watchdog.m_aborted = false;
+	m_watchdog.m_start = Clock::now();
+}
+
+LuaDevice::Watchdog::Call::~Call() {
+	if(--m_watchdog.m_depth) return;
+	m_watchdog.m_stats.calls++;
+	m_watchdog.m_stats.time += Clock::now() - m_watchdog.m_start;
+}
@@ -11,7 +11,11 @@
 
 extern "C"
 {
-	#if __has_include(<lua5.3/lua.h>)
+	#if defined(USE_LUAJIT)
+		#include <lua.h>
+		#include <lualib.h>
+		#include <lauxlib.h>
+	#elif __has_include(<lua5.3/lua.h>)
 		#include <lua5.3/lua.h>
 		#include <lua5.3/lualib.h>
 		#include <lua5.3/lauxlib.h>
@@ -25,6 +29,7 @@ extern "C"
 }
 #include <LuaBridge/LuaBridge.h>
 
+#include <chrono>
 #include <cstring>
 #include <string>
 #include <QPoint>
@@ -32,14 +37,69 @@ extern "C"
 
 
 class LuaDevice : public Device {
+public:
+	/**
+	 * Limits the time of every call into the device's state and accounts for it.
+	 * A count hook checks the budget every few thousand instructions and raises
+	 * an error in the script once it is exceeded, so a script cannot hang its caller.
+	 * Lives in the state's registry and is installed before any script runs,
+	 * so loading a script and coroutines created meanwhile are limited as well.
+	 */
+	class Watchdog {
+	public:
+		typedef std::chrono::steady_clock Clock;
+		static constexpr std::chrono::milliseconds default_budget{100};	// scripts without cpu_budget_ms
+		struct Statistics {
+			uint64_t calls = 0;
+			uint64_t aborted = 0;
+			Clock::duration time = Clock::duration::zero();
+		};
+
+		/**
+		 * Wraps a call from C++ into the script, nested calls count once
+		 */
+		class Call {
+			Watchdog& m_watchdog;
+		public:
+			Call(Watchdog& watchdog);
+			~Call();
+		};
+
+		/**
+		 * Creates the watchdog owned by L and sets the hook, which new coroutines inherit
+		 */
+		static Watchdog& install(lua_State* L);
+		static Watchdog& of(lua_State* L);
+		void setBudget(std::chrono::milliseconds budget);	// zero disables the limit
+		const Statistics& getStatistics() const;
+
+	private:
+		static constexpr int hook_interval = 10000;		// instructions
+
+		std::chrono::milliseconds m_budget = default_budget;
+		Clock::time_point m_start;
+		unsigned m_depth = 0;
+		bool m_aborted = false;
+		Statistics m_stats;
+
+		static void hook(lua_State* L, lua_Debug*);
+	};
+
+private:
+	// Each device has its own state, so devices do not block each other.
+	// Declared first to outlive all references into it.
+	std::unique_ptr<lua_State, void(*)(lua_State*)> m_state;	// closed by LuaAllocator::close
 	luabridge::LuaRef m_env;
+	const DeviceClass m_classname;
 
 	luabridge::LuaRef m_getGraphBufferLayout = m_env["getGraphBufferLayout"];
 	luabridge::LuaRef m_initializeGraphBuffer = m_env["initializeGraphBuffer"];
-	lua_State* L;				// to register functions and Format
+	lua_State* L;				// to register functions and Format, owned by m_state
+	Watchdog& m_watchdog;		// owned by m_state
 
 	bool implementsGraphFunctions();
 	static void declarePixelFormat(lua_State* L);
+	void configureMemory();
 
 public:
 
@@ -49,11 +109,29 @@ public:
 		luabridge::LuaRef m_getPinLayout;
 		luabridge::LuaRef m_getPin;
 		luabridge::LuaRef m_setPin;
+		PinLayout m_layout;				// parsed result of m_getPinLayout
+		bool m_layout_valid = false;
+		Watchdog& m_watchdog;
+
+		PinLayout readPinLayout();
 
 	public:
-		PIN_Interface_Lua(luabridge::LuaRef& ref);
+		// Numeric pin states, exported to scripts as gpio.LOW, gpio.HIGH and gpio.UNSET
+		enum State : lua_Integer {
+			LOW = 0,
+			HIGH = 1,
+			UNSET = 2
+		};
+		static void declarePinStates(lua_State* L);
+
+		PIN_Interface_Lua(luabridge::LuaRef& ref, Watchdog& watchdog);
 		~PIN_Interface_Lua();
-		PinLayout getPinLayout() override;
+		const PinLayout& getPinLayout() override;
+		/**
+		 * The layout is read from the script once and then cached.
+		 * Scripts call invalidatePinLayout() if their layout changes.
+		 */
+		void invalidatePinLayout();
 		gpio::Tristate getPin(DevicePin num) override;
 		void setPin(DevicePin num, gpio::Tristate val) override;
 		static bool implementsInterface(const luabridge::LuaRef& ref);
@@ -61,10 +139,17 @@ public:
 
 	class SPI_Interface_Lua : public Device::SPI_Interface {
 		luabridge::LuaRef m_send;
+		luabridge::LuaRef m_sendBurst;	// optional
+		Watchdog& m_watchdog;
 	public:
-		SPI_Interface_Lua(luabridge::LuaRef& ref);
+		SPI_Interface_Lua(luabridge::LuaRef& ref, Watchdog& watchdog);
 		~SPI_Interface_Lua();
 		gpio::SPI_Response send(gpio::SPI_Command byte) override;
+		/**
+		 * receiveSPIBurst(bytes) gets all bytes as one string and may return
+		 * the responses as a string of the same length
+		 */
+		void sendBurst(const gpio::SPI_Command* bytes, size_t count, gpio::SPI_Response* responses) override;
 		static bool implementsInterface(const luabridge::LuaRef& ref);
 	};
 
@@ -72,8 +157,9 @@ public:
 		luabridge::LuaRef m_getConf;
 		luabridge::LuaRef m_setConf;
 		luabridge::LuaRef& m_env;	// for building table
+		Watchdog& m_watchdog;
 	public:
-		Config_Interface_Lua(luabridge::LuaRef& ref);
+		Config_Interface_Lua(luabridge::LuaRef& ref, Watchdog& watchdog);
 		~Config_Interface_Lua();
 		Config getConfig() override;
 		bool setConfig(Config conf) override;
@@ -84,8 +170,9 @@ public:
 		luabridge::LuaRef m_onClick;
 		luabridge::LuaRef m_onKeypress;
 		luabridge::LuaRef& m_env; // for building table
+		Watchdog& m_watchdog;
 	public:
-		Input_Interface_Lua(luabridge::LuaRef& ref);
+		Input_Interface_Lua(luabridge::LuaRef& ref, Watchdog& watchdog);
 		~Input_Interface_Lua();
 		void onClick(bool active) override;
 		void onKeypress(Key key, bool active) override;
@@ -93,10 +180,31 @@ public:
 		static bool implementsInterface(const luabridge::LuaRef& ref);
 	};
 
+	/**
+	 * Runs the tasks started with spawn(fun, ...) in loadscript.lua,
+	 * which sleep(ms) on the simulation clock. Only for scripts that
+	 * left a task while loading.
+	 */
+	class Timer_Interface_Lua : public Device::Timer_Interface {
+		luabridge::LuaRef m_runDueTasks;
+		Watchdog& m_watchdog;
+	public:
+		Timer_Interface_Lua(Device* device, lua_State* L, Watchdog& watchdog);
+		~Timer_Interface_Lua();
+		void onWakeup(Time now) override;
+		// simulation_time() in milliseconds, also usable before a device exists
+		static void declareSimulationTime(lua_State* L);
+		static bool implementsInterface(lua_State* L);
+	};
+
+	/**
+	 * Takes ownership of L, which env has to be loaded into
+	 */
 	LuaDevice(const DeviceID& id, luabridge::LuaRef env, lua_State* L);
 	~LuaDevice();
 
 	Layout getLayout() override;
+	std::string getStatistics() override;
 	void initializeBuffer() override;
 	void createBuffer(unsigned iconSizeMinimum, QPoint offset) override;
 
@@ -8,105 +8,24 @@
 using namespace gpio;
 using namespace std;
 
-Embedded::Embedded(const std::string& host, const std::string& port) : QWidget(), m_host(host), m_port(port) {
+Embedded::Embedded(const std::string& host, const std::string& port) : QWidget(), m_board(host, port) {
 	setMinimumSize(m_windowsize);
 	setBackground(m_bkgnd_path);
 
 	m_pin_dialog = new PinOptions(this);
 	connect(m_pin_dialog, &PinOptions::pinsChanged, this, &Embedded::pinsChanged);
-}
-
-Embedded::~Embedded() = default;
-
-PinNumber Embedded::translatePinToGpioOffs(PinNumber pin) {
-	auto pin_obj = m_pins.find(pin);
-	if(pin_obj == m_pins.end()) {
-		return invalidPin();
-	}
-	return pin_obj->second.gpio_offs;
-}
-
-Embedded::PinRegister Embedded::translateGpioToGlobal(State state) {
-	PinRegister ext = 0;
-	for(const auto& [global, pin_obj] : m_pins) {
-		ext |= (state.pins[pin_obj.gpio_offs] == gpio::Pinstate::HIGH ? 1 : 0) << global;
-	}
-	return ext;
-}
-
-gpio::PinNumber Embedded::invalidPin() {
-	static_assert(gpio::max_num_pins < numeric_limits<gpio::PinNumber>::max(),
-				  "Invalid Pin hides a valid pin number");
-	return numeric_limits<gpio::PinNumber>::max();
-}
 
-GPIOPinLayout Embedded::getPins() {
-	return m_pins;
+	m_board.start();
 }
 
-bool Embedded::isPin(gpio::PinNumber pin) {
-	return m_pins.find(pin) != m_pins.end();
-}
-
-/* GPIO */
-
-bool Embedded::timerUpdate() { // return: new connection?
-	if(m_connected && !m_gpio.update()) {
-		emit(connectionLost());
-		m_connected = false;
-	}
-	if(m_connected) {
-		for (auto &[global, info]: m_pins) {
-			for (auto &iof: info.iofs) {
-				if (iof.type == IOFType::SPI) {
-					iof.active = m_gpio.state.pins[info.gpio_offs] == gpio::Pinstate::IOF_SPI;
-				}
-			}
-		}
-	}
-	else {
-		m_connected = m_gpio.setupConnection(m_host.c_str(), m_port.c_str());
-		if(m_connected) {
-			return true;
-		}
-	}
-	return false;
-}
-
-Embedded::PinRegister Embedded::getState() {
-	return translateGpioToGlobal(m_gpio.state);
-}
-
-bool Embedded::gpioConnected() const {
-	return m_connected;
-}
-
-void Embedded::registerIOF_PIN(PinNumber global, GpioClient::OnChange_PIN fun) {
-	gpio::PinNumber gpio_offs = translatePinToGpioOffs(global);
-	if(!m_gpio.isIOFactive(gpio_offs)) {
-		m_gpio.registerPINOnChange(gpio_offs, fun);
-	}
-}
-
-void Embedded::registerIOF_SPI(PinNumber global, GpioClient::OnChange_SPI fun, bool no_response) {
-	gpio::PinNumber gpio_offs = translatePinToGpioOffs(global);
-	if(!m_gpio.isIOFactive(gpio_offs)) {
-		m_gpio.registerSPIOnChange(gpio_offs, fun, no_response);
-	}
-}
+Embedded::~Embedded() = default;
 
-void Embedded::closeIOF(PinNumber global) {
-	m_gpio.closeIOFunction(translatePinToGpioOffs(global));
+Board& Embedded::getBoard() {
+	return m_board;
 }
 
 void Embedded::destroyConnection() {
-	m_gpio.destroyConnection();
-}
-
-void Embedded::setBit(gpio::PinNumber global, gpio::Tristate state) {
-	if(m_connected) {
-		m_gpio.setBit(translatePinToGpioOffs(global), state);
-	}
+	m_board.stop();
 }
 
 /* QT */
@@ -124,8 +43,8 @@ QSize Embedded::getDistortedSize(QSize minimum) {
 }
 
 QPoint Embedded::getDistortedPositionPin(gpio::PinNumber global) {
-	auto pin = m_pins.find(global);
-	if(pin == m_pins.end()) {
+	auto pin = m_board.getPins().find(global);
+	if(pin == m_board.getPins().end()) {
 		cerr << "Pin " << (int) global << " could not be found on the board" << endl;
 		return {0,0};
 	}
@@ -144,7 +63,7 @@ void Embedded::paintEvent(QPaintEvent *) {
 	QPen pen(Qt::black);
 	painter.setPen(pen);
 
-	for(const auto& [pin, info] : m_pins) {
+	for(const auto& [pin, info] : m_board.getPins()) {
 		painter.drawRect(QRect(getDistortedPosition(info.pos), getDistortedSize(QSize(iconSizeMinimum(), iconSizeMinimum()))));
 		painter.drawText(getDistortedPosition(QPoint(info.pos.x(),info.pos.y()+iconSizeMinimum())), QString::number(pin));
 	}
@@ -157,7 +76,7 @@ void Embedded::resizeEvent(QResizeEvent*) {
 }
 
 void Embedded::mousePressEvent(QMouseEvent *e) {
-	for(const auto& [pin, info] : m_pins) {
+	for(const auto& [pin, info] : m_board.getPins()) {
 		if(QRect(getDistortedPosition(info.pos), getDistortedSize(QSize(iconSizeMinimum(), iconSizeMinimum()))).contains(e->pos())) {
 			QSize image_size = getDistortedSize(QSize(iconSizeMinimum(), iconSizeMinimum()));
 			QPoint hotspot = QPoint(image_size.width()/2,image_size.height()/2);
@@ -198,10 +117,6 @@ void Embedded::updateBackground() {
 }
 
 void Embedded::fromJSON(QJsonObject json) {
-	if(!json.contains("pins") || !json["pins"].isArray()) {
-		cerr << "[Embedded] JSON missing pins entry" << endl;
-		return;
-	}
 	if(json.contains("window") && json["window"].isObject()) {
 		QJsonObject window = json["window"].toObject();
 		unsigned windowsize_x = window["windowsize"].toArray().at(0).toInt();
@@ -210,49 +125,11 @@ void Embedded::fromJSON(QJsonObject json) {
 		setMinimumSize(windowsize_x, windowsize_y);
 		setBackground(window["background"].toString());
 	}
-
-	m_pins.clear();
-	QJsonArray pins = json["pins"].toArray();
-	for(const auto& pin_obj : pins) {
-		QJsonObject pin = pin_obj.toObject();
-		if(!pin.contains("global") || !pin["global"].isDouble()
-		|| !pin.contains("gpio_offs") || !pin["gpio_offs"].isDouble()
-		|| !pin.contains("pos_x") || !pin["pos_x"].isDouble()
-		|| !pin.contains("pos_y") || !pin["pos_y"].isDouble()) {
-			cerr << "[Embedded] JSON missing global/gpio offs/position entry for a pin" << endl;
-			continue;
-		}
-		gpio::PinNumber global = pin["global"].toInt();
-		gpio::PinNumber gpio_offs = pin["gpio_offs"].toInt();
-		list<IOF> iofs;
-		if(pin.contains("iofs") && pin["iofs"].isArray()) {
-			QJsonArray iofs_obj = pin["iofs"].toArray();
-			for (const auto &iof_obj: iofs_obj) {
-				QJsonObject iof = iof_obj.toObject();
-				if(!iof.contains("type") || !iof["type"].isString()) {
-					cerr << "[Embedded] JSON missing type for iof of pin " << (int) global << endl;
-					continue;
-				}
-				bool active = iof["active"].toBool(false);
-				IOFType type;
-				QString type_str = iof["type"].toString();
-				if (type_str == "UART") type = IOFType::UART;
-				else if (type_str == "SPI") type = IOFType::SPI;
-				else if (type_str == "PWM") type = IOFType::PWM;
-				else {
-					cerr << "[Embedded] JSON has invalid iof type " << type_str.toStdString() << " for pin " << (int) global << endl;
-					continue;
-				}
-				iofs.push_back(IOF{.type=type, .active=active});
-			}
-		}
-		QPoint pos = QPoint(pin["pos_x"].toInt(), pin["pos_y"].toInt());
-		m_pins.emplace(global, GPIOPin{.gpio_offs=gpio_offs,.iofs=iofs, .pos=pos});
-	}
+	m_board.fromJSON(json);
 }
 
 QJsonObject Embedded::toJSON() {
-	QJsonObject json;
+	QJsonObject json = m_board.toJSON();
 	QJsonObject window;
 	window["background"] = m_bkgnd_path;
 	QJsonArray windowsize;
@@ -260,58 +137,17 @@ QJsonObject Embedded::toJSON() {
 	windowsize.append(minimumSize().height());
 	window["windowsize"] = windowsize;
 	json["window"] = window;
-	QJsonArray pins;
-	for(const auto& [global, pin] : m_pins) {
-		QJsonObject pin_obj;
-		pin_obj["global"] = global;
-		pin_obj["gpio_offs"] = pin.gpio_offs;
-		QJsonArray iofs;
-		for(const auto& iof : pin.iofs) {
-			QJsonObject iof_obj;
-			QString type;
-			switch(iof.type) {
-				case IOFType::PWM:
-					type = "PWM";
-					break;
-				case IOFType::SPI:
-					type = "SPI";
-					break;
-				case IOFType::UART:
-					type = "UART";
-					break;
-			}
-			iof_obj["type"] = type;
-			iof_obj["active"] = iof.active;
-			iofs.append(iof_obj);
-		}
-		if(!iofs.empty()) {
-			pin_obj["iofs"] = iofs;
-		}
-		pin_obj["pos_x"] = pin.pos.x();
-		pin_obj["pos_y"] = pin.pos.y();
-		pins.append(pin_obj);
-	}
-	json["pins"] = pins;
 	return json;
 }
 
 /* DIALOG */
 
 void Embedded::pinsChanged(std::list<std::pair<gpio::PinNumber, IOF>> iofs) {
-	for(const auto& [global, iof] : iofs) {
-		auto pin = m_pins.find(global);
-		if(pin == m_pins.end()) continue;
-		IOFType type = iof.type;
-		auto pin_iof = std::find_if(pin->second.iofs.begin(), pin->second.iofs.end(),[type](IOF i){
-			return type == i.type;
-		});
-		if(pin_iof == pin->second.iofs.end()) continue;
-		pin_iof->active = iof.active;
-	}
+	m_board.setIOFs(iofs);
 	emit(pinSettingsChanged(iofs));
 }
 
 void Embedded::openPinOptions() {
-	m_pin_dialog->setPins(getPins());
+	m_pin_dialog->setPins(m_board.getPins());
 	m_pin_dialog->exec();
 }
@@ -1,9 +1,8 @@
 #pragma once
 
-#include "types.h"
 #include "options.h"
 
-#include <gpio-client.hpp>
+#include <board.h>
 
 #include <QWidget>
 #include <QJsonObject>
@@ -15,18 +14,8 @@ const QString DRAG_TYPE_CABLE = "cable";
 class Embedded : public QWidget {
 	Q_OBJECT
 
-public:
-	typedef uint64_t PinRegister;
-
-private:
 	PinOptions *m_pin_dialog;
-	GPIOPinLayout m_pins;
-
-	GpioClient m_gpio;
-
-	const std::string m_host;
-	const std::string m_port;
-	bool m_connected = false;
+	Board m_board;
 
 	QPixmap m_bkgnd;
 	QString m_bkgnd_path = ":/img/virtual_hifive.png";
@@ -40,20 +29,12 @@ private:
 	void setBackground(QString path);
 	void updateBackground();
 
-	gpio::PinNumber translatePinToGpioOffs(gpio::PinNumber pin);
-	PinRegister translateGpioToGlobal(gpio::State state);
-
 public:
 	Embedded(const std::string& host, const std::string& port);
 	~Embedded();
 
-	bool timerUpdate();
-	PinRegister getState();
-	bool gpioConnected() const;
+	Board& getBoard();
 	void destroyConnection();
-	GPIOPinLayout getPins();
-	bool isPin(gpio::PinNumber pin);
-	gpio::PinNumber invalidPin();
 
 	void fromJSON(QJsonObject json);
 	QJsonObject toJSON();
@@ -67,13 +48,6 @@ public:
 private slots:
 	void pinsChanged(std::list<std::pair<gpio::PinNumber, IOF>> iofs);
 
-public slots:
-	void registerIOF_PIN(gpio::PinNumber global, GpioClient::OnChange_PIN fun);
-	void registerIOF_SPI(gpio::PinNumber global, GpioClient::OnChange_SPI fun, bool noresponse);
-	void closeIOF(gpio::PinNumber global);
-	void setBit(gpio::PinNumber global, gpio::Tristate state);
-
 signals:
-	void connectionLost();
 	void pinSettingsChanged(std::list<std::pair<gpio::PinNumber, IOF>> iofs);
 };
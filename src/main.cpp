@@ -1,12 +1,15 @@
 #include "window/window.h"
 #include "device/factory/factory.h"
+#include "core/headless.h"
 
 #include <QApplication>
+#include <QCoreApplication>
 #include <QDirIterator>
 
 #include <string>
 #include <vector>
 #include <iostream>
+#include <memory>
 
 class InputParser{
 	public:
@@ -33,14 +36,18 @@ class InputParser{
 
 
 int main(int argc, char* argv[]) {
-	QApplication a(argc, argv);
+	InputParser input(argc, argv);
+	const bool headless = input.cmdOptionExists("--headless");
+	std::unique_ptr<QCoreApplication> a = headless ?
+			std::make_unique<QCoreApplication>(argc, argv) : std::make_unique<QApplication>(argc, argv);
 	std::string configfile = ":/conf/oled_shield.json";
 	std::string scriptpath = "";
 	std::string host = "localhost";
 	std::string port = "1400";
+	std::string shm_prefix = "";
 	bool overwrite_integrated_devices = false;
+	Factory factory;	// shared by help text, breadboard and headless mode, scans the built-in devices once
 
-	InputParser input(argc, argv);
 	if(input.cmdOptionExists("-h") || input.cmdOptionExists("--help")){
 		std::cout << "Usage: " << argv[0] << " [options]" << std::endl;
 		std::cout << "    options:" << std::endl;
@@ -57,7 +64,6 @@ int main(int argc, char* argv[]) {
 			std::cout << std::endl;
 		}
 		std::cout << "\t-s <custom_device_folder>" << std::endl;
-		Factory factory;
 		std::cout << "\t\t\t Builtin scripted devices:";
 		std::list<DeviceClass> lua_devices = factory.getLUADevices();
 		if(!lua_devices.size()) std::cout << " NONE";
@@ -75,6 +81,8 @@ int main(int argc, char* argv[]) {
 		std::cout << "\t--overwrite \tCustom scripts will take priority in registry" << std::endl;
 		std::cout << "\t-d <target_host> (default " << host << ")" << std::endl;
 		std::cout << "\t-p <portnumber>\t (default " << port << ")" << std::endl;
+		std::cout << "\t--headless \tSimulate without GUI, quits when the connection is closed" << std::endl;
+		std::cout << "\t--shm <prefix>\t Export device buffers and pin state as /<prefix>-device-<id> and /<prefix>-pins" << std::endl;
 		return 0;
 	}
 
@@ -107,13 +115,36 @@ int main(int argc, char* argv[]) {
 			scriptpath = scriptpath_c;
 		}
 	}
+	{
+		const std::string &shm_c = input.getCmdOption("--shm");
+		if (!shm_c.empty()){
+			shm_prefix = shm_c;
+		}
+	}
 	{
 		overwrite_integrated_devices = input.cmdOptionExists("--overwrite");
 	}
 
-	MainWindow w(scriptpath.c_str(), host.c_str(), port.c_str(), overwrite_integrated_devices);
+	if(headless) {
+		Headless h(factory, host, port);
+		h.additionalLuaDir(scriptpath, overwrite_integrated_devices);
+		if(!h.loadJSON(QString(configfile.c_str()))) {
+			return 1;
+		}
+		if(!shm_prefix.empty()) {
+			h.exportSharedMemory(shm_prefix);
+		}
+		QObject::connect(&h, &Headless::finished, a.get(), &QCoreApplication::quit);
+		h.start();
+		return a->exec();
+	}
+
+	MainWindow w(factory, scriptpath.c_str(), host.c_str(), port.c_str(), overwrite_integrated_devices);
 	w.show();
 	w.loadJSON(QString(configfile.c_str()));
+	if(!shm_prefix.empty()) {
+		w.exportSharedMemory(shm_prefix);
+	}
 
-	return a.exec();
+	return a->exec();
 }
@@ -1,15 +1,13 @@
 #include "central.h"
 
 #include <QVBoxLayout>
-#include <QTimer>
 #include <QJsonParseError>
 
 /* Constructor */
 
-Central::Central(const std::string& host, const std::string& port, QWidget *parent) : QWidget(parent) {
-	m_breadboard = new Breadboard();
+Central::Central(Factory& factory, const std::string& host, const std::string& port, QWidget *parent) : QWidget(parent) {
 	m_embedded = new Embedded(host, port);
-	m_breadboard->setEmbedded(m_embedded);
+	m_breadboard = new Breadboard(factory, m_embedded);
 
 	auto *layout = new QVBoxLayout(this);
 	layout->addWidget(m_embedded);
@@ -22,18 +20,22 @@ Central::Central(const std::string& host, const std::string& port, QWidget *pare
 	m_breadboard->setOverlay(m_overlay);
 	m_embedded->stackUnder(m_overlay);
 
-	auto *timer = new QTimer(this);
-	connect(timer, &QTimer::timeout, this, &Central::timerUpdate);
-	timer->start(250);
-
-	connect(m_embedded, &Embedded::connectionLost, [this](){
+	Board* board = &m_embedded->getBoard();
+	connect(board, &Board::connectionEstablished, [this](){
+		emit(connectionUpdate(true));
+	});
+	connect(board, &Board::connectionLost, [this](){
 		emit(connectionUpdate(false));
 	});
 	connect(m_embedded, &Embedded::pinSettingsChanged, this, &Central::pinSettingsChanged);
+	connect(board, &Board::stateChanged, m_breadboard, &Breadboard::pinsChanged);
 	connect(this, &Central::connectionUpdate, m_breadboard, &Breadboard::connectionUpdate);
 }
 
-Central::~Central() = default;
+Central::~Central() {
+	// the breadboard closes its IOFs on the embedded board, so it has to go first
+	delete m_breadboard;
+}
 
 void Central::resizeEvent(QResizeEvent*) {
 	m_overlay->resize(width(), height());
@@ -118,6 +120,10 @@ void Central::loadLUA(const std::string& dir, bool overwrite_integrated_devices)
 	m_breadboard->additionalLuaDir(dir, overwrite_integrated_devices);
 }
 
+void Central::exportSharedMemory(const std::string& prefix) {
+	m_breadboard->exportSharedMemory(prefix);
+}
+
 void Central::pinSettingsChanged(const std::list<std::pair<gpio::PinNumber, IOF>>& iofs) {
 	for(const auto& [global, iof] : iofs) {
 		if(iof.type == IOFType::SPI) {
@@ -126,15 +132,3 @@ void Central::pinSettingsChanged(const std::list<std::pair<gpio::PinNumber, IOF>
 	}
 	m_breadboard->printConnections();
 }
-
-/* Timer */
-
-void Central::timerUpdate() {
-	bool reconnect = m_embedded->timerUpdate();
-	if(reconnect) {
-		emit(connectionUpdate(true));
-	}
-	if(m_embedded->gpioConnected()) {
-		m_breadboard->timerUpdate(m_embedded->getState());
-	}
-}
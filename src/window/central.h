@@ -14,13 +14,14 @@ class Central : public QWidget {
 	Overlay *m_overlay;
 
 public:
-	Central(const std::string& host, const std::string& port, QWidget *parent);
+	Central(Factory& factory, const std::string& host, const std::string& port, QWidget *parent);
 	~Central();
 	void destroyConnection();
 	bool toggleDebug();
 	void saveJSON(const QString& file);
 	void loadJSON(const QString& file);
 	void loadLUA(const std::string& dir, bool overwrite_integrated_devices);
+	void exportSharedMemory(const std::string& prefix);
 	void resizeEvent(QResizeEvent*) override;
 
 public slots:
@@ -28,7 +29,6 @@ public slots:
 	void openEmbeddedOptions();
 
 private slots:
-	void timerUpdate();
 	void pinSettingsChanged(const std::list<std::pair<gpio::PinNumber, IOF>>& iofs);
 
 signals:
@@ -6,12 +6,12 @@
 #include <QStatusBar>
 #include <QFileDialog>
 
-MainWindow::MainWindow(const std::string& additional_device_dir,
+MainWindow::MainWindow(Factory& factory, const std::string& additional_device_dir,
 		const std::string& host, const std::string& port,
 		bool overwrite_integrated_devices, QWidget *parent) : QMainWindow(parent) {
 	setWindowTitle("MainWindow");
 
-	m_central = new Central(host, port, this);
+	m_central = new Central(factory, host, port, this);
 	m_central->loadLUA(additional_device_dir, overwrite_integrated_devices);
 	setCentralWidget(m_central);
 	connect(m_central, &Central::connectionUpdate, [this](bool active){
@@ -28,6 +28,10 @@ void MainWindow::loadJSON(const QString& configfile) {
 	m_central->loadJSON(configfile);
 }
 
+void MainWindow::exportSharedMemory(const std::string& prefix) {
+	m_central->exportSharedMemory(prefix);
+}
+
 void MainWindow::saveJSON(const QString& file) {
 	statusBar()->showMessage("Saving breadboard status to config file " + file, 10000);
 	m_central->saveJSON(file);
@@ -25,7 +25,8 @@ class MainWindow : public QMainWindow {
 	void removeJsonDir(const QString& dir);
 
 public:
-	MainWindow(const std::string& additional_device_dir, const std::string& host, const std::string& port, bool overwrite_integrated_devices=false, QWidget *parent=0);
+	MainWindow(Factory& factory, const std::string& additional_device_dir, const std::string& host, const std::string& port, bool overwrite_integrated_devices=false, QWidget *parent=0);
 	~MainWindow();
 	void loadJSON(const QString& configfile);
+	void exportSharedMemory(const std::string& prefix);
 };